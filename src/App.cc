@@ -35,6 +35,7 @@
 #include <signal.h> 
 #include <string.h>
 #include <utility>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include "boost/regex.hpp"
@@ -47,8 +48,9 @@
 #include "miutil/timeconvert.h"
 #include "miconfparser/miconfparser.h"
 #include "kvalobs/kvPath.h"
-#include "kvsubscribe/HttpSendData.h"
 #include "App.h"
+#include "DeliveryQueue.h"
+#include "KvDelivery.h"
 
 using namespace std;
 using namespace milog;
@@ -216,7 +218,23 @@ App::App(int argn,
   :KvBaseApp( argn, argv),test_(false),
    refDataList(getKvServers(App::getConfiguration())),
    debug_(false),
-   http(refDataList.front()){
+   useInotify_(true),
+   rescanInterval_(60),
+   tailRead_(false),
+   quietPeriod_(200),
+   collectThreads_(4),
+   splitThreads_(2),
+   framingQueueSize_(64),
+   splitQueueSize_(256),
+   sendQueueSize_(4096),
+   batchSize_(50),
+   batchLingerMs_(200),
+   kvserverConnections_(4),
+   sendWindow_(16),
+   breakerFailures_(5),
+   breakerCooldownMs_(5000),
+   breakerMaxCooldownMs_(300000),
+   maxRetries_(20){
    string            kvservers;
    ConfSection       *myConf=App::getConfiguration();
 
@@ -235,11 +253,92 @@ App::App(int argn,
       for( string &server: refDataList)
         ost << " " << server;
       LOGINFO("Pushing data to kvDataInputd on: " << ost.str());
-      refDataList.pop_front(); // This server is all ready configured with the http client.
    }
 
 
    debug_ = myConf->getValue("debug").valAsBool(false);
+   useInotify_ = myConf->getValue("inotify").valAsBool(true);
+   rescanInterval_ = myConf->getValue("rescan_interval").valAsInt(60);
+   tailRead_ = myConf->getValue("tail_read").valAsBool(false);
+   quietPeriod_ = myConf->getValue("quiet_period_ms").valAsInt(200);
+   collectThreads_ = myConf->getValue("collect_threads").valAsInt(4);
+   splitThreads_ = myConf->getValue("split_threads").valAsInt(2);
+   framingQueueSize_ = myConf->getValue("framing_queue_size").valAsInt(64);
+   splitQueueSize_ = myConf->getValue("split_queue_size").valAsInt(256);
+   sendQueueSize_ = myConf->getValue("send_queue_size").valAsInt(4096);
+   batchSize_ = myConf->getValue("batch_size").valAsInt(50);
+   batchLingerMs_ = myConf->getValue("batch_linger_ms").valAsInt(200);
+
+   //The decoders that accepts many reports in one message.
+   for( ValElement &e: myConf->getValue("batch_decoders")) {
+      string decoder = boost::trim_copy(e.valAsString(""));
+
+      if( !decoder.empty() )
+         batchDecoders_.insert( decoder );
+   }
+
+   if( quietPeriod_ < 0 )
+      quietPeriod_ = 0;
+
+   if( rescanInterval_ < 1 )
+      rescanInterval_ = 1;
+
+   if( collectThreads_ < 1 )
+      collectThreads_ = 1;
+
+   if( splitThreads_ < 1 )
+      splitThreads_ = 1;
+
+   if( framingQueueSize_ < 1 )
+      framingQueueSize_ = 1;
+
+   if( splitQueueSize_ < 1 )
+      splitQueueSize_ = 1;
+
+   if( sendQueueSize_ < 1 )
+      sendQueueSize_ = 1;
+
+   if( batchSize_ < 1 )
+      batchSize_ = 1;
+
+   if( batchLingerMs_ < 0 )
+      batchLingerMs_ = 0;
+
+   //Each kvserver is delivered to from its own cursor in the delivery
+   //queue. send_timeout_ms may be a list with a timeout for each
+   //kvserver. There is kvserver_connections open connections to each
+   //kvserver, and up to send_window messages in flight to it. The
+   //circuit breaker stops the sending to a kvserver that is down, and
+   //a message kvalobs will not save is given up after max_retries.
+   for( ValElement &e: myConf->getValue("send_timeout_ms")) {
+      int timeout = e.valAsInt(30000);
+      sendTimeouts_.push_back( timeout < 1 ? 1 : timeout );
+   }
+
+   kvserverConnections_ = myConf->getValue("kvserver_connections").valAsInt(4);
+   sendWindow_ = myConf->getValue("send_window").valAsInt(16);
+   breakerFailures_ = myConf->getValue("breaker_failures").valAsInt(5);
+   breakerCooldownMs_ = myConf->getValue("breaker_cooldown_ms").valAsInt(5000);
+   breakerMaxCooldownMs_ = myConf->getValue("breaker_max_cooldown_ms").valAsInt(300000);
+   maxRetries_ = myConf->getValue("max_retries").valAsInt(20);
+
+   if( kvserverConnections_ < 1 )
+      kvserverConnections_ = 1;
+
+   if( sendWindow_ < 1 )
+      sendWindow_ = 1;
+
+   if( breakerFailures_ < 1 )
+      breakerFailures_ = 1;
+
+   if( breakerCooldownMs_ < 1 )
+      breakerCooldownMs_ = 1;
+
+   if( breakerMaxCooldownMs_ < breakerCooldownMs_ )
+      breakerMaxCooldownMs_ = breakerCooldownMs_;
+
+   if( maxRetries_ < 1 )
+      maxRetries_ = 1;
 
    if (myConf->getValue("ignore_files_before_startup").valAsBool(false))
      ignoreFilesBeforeStartup = pt::second_clock::universal_time();
@@ -273,12 +372,26 @@ App::App(int argn,
    createDir( tmpdir_ );
    createDir( logdir_ );
 
-   synopdir_=getDir(myConf, "synopdir");
+   //synopdir may be a list of directories.
+   for( ValElement &e: myConf->getValue("synopdir")) {
+      string dir = fixPath(boost::trim_copy(e.valAsString("")));
 
-   if(synopdir_.empty())
-     usage();
+      if( dir.empty() )
+         continue;
+
+      dir = checkdir(dir);
 
-   synopdir_=checkdir(synopdir_);
+      if( std::find(synopdirs_.begin(), synopdirs_.end(), dir) != synopdirs_.end() ) {
+         LOGWARN("synopdir: '" << dir << "' is given more than once.");
+         continue;
+      }
+
+      LOGINFO("synopdir: '" << dir << "'");
+      synopdirs_.push_back(dir);
+   }
+
+   if(synopdirs_.empty())
+     usage();
    raports = getRaportConf( myConf );
 
    setSigHandlers();
@@ -324,35 +437,80 @@ App::checkdir(const std::string &dir_, bool rwaccess)
 }
 
 
-kvalobs::datasource::Result
-App::sendDataToKvalobs(const std::string &message, 
-                       const std::string &obsType,
-                       std::string &sentTo)
+bool
+App::startDelivery()
+{
+   string dir = workdir_ + "queue/";
+   size_t i = 0;
+   KvDelivery::Conf conf;
+
+   createDir( dir );
+   queue.reset( new DeliveryQueue( dir, refDataList ) );
+
+   if( ! queue->open() )
+      return false;
+
+   //Nothing is sent to kvalobs in test mode.
+   if( test_ )
+      return true;
+
+   conf.batchDecoders = batchDecoders_;
+   conf.batchSize = batchSize_;
+   conf.batchLingerMs = batchLingerMs_;
+   conf.connections = kvserverConnections_;
+   conf.window = sendWindow_;
+   conf.breakerFailures = breakerFailures_;
+   conf.breakerCooldownMs = breakerCooldownMs_;
+   conf.breakerMaxCooldownMs = breakerMaxCooldownMs_;
+   conf.maxRetries = maxRetries_;
+   conf.data2kvdir = data2kvdir_;
+
+   for( const string &server: refDataList ) {
+      int timeout = 30000;
+
+      if( ! sendTimeouts_.empty() )
+         timeout = sendTimeouts_[ std::min( i, sendTimeouts_.size() - 1 ) ];
+
+      deliveries.push_back( std::make_unique<KvDelivery>( *queue, i, server, conf, timeout ) );
+      i++;
+   }
+
+   for( std::unique_ptr<KvDelivery> &delivery: deliveries )
+      delivery->start();
+
+   return true;
+}
+
+void
+App::stopDelivery()
+{
+   for( std::unique_ptr<KvDelivery> &delivery: deliveries )
+      delivery->stop();
+
+   deliveries.clear();
+
+   if( queue )
+      queue->saveCursors();
+}
+
+bool
+App::queueData(const std::string &message,
+               const std::string &obsType,
+               bool priority)
 {
-  kvalobs::datasource::Result resToReturn;
-  ostringstream ost;
-  try {
-    ost << http.host();
-    resToReturn = http.newData(message, obsType);
-  }
-  catch( const std::exception &ex) {
-    resToReturn.res = kvalobs::datasource::ERROR;
-    resToReturn.message=ex.what();
-    ost << " (FAILED)";
-  }
+  if( ! queue->append( obsType, message, priority ) )
+    return false;
 
-  for( string &server : refDataList ) {
-    try {
-      ost << ", " << server;
-      resToReturn = http.newData(server, message, obsType);
-    }
-    catch( const std::exception &ex) {
-      ost << " (FAILED)";
-    }
-  }
+  for( std::unique_ptr<KvDelivery> &delivery: deliveries )
+    delivery->wakeUp();
+
+  return true;
+}
 
-  sentTo = ost.str();
-  return resToReturn;
+bool
+App::syncQueuedData()
+{
+  return queue->sync();
 }
 
 
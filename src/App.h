@@ -32,10 +32,13 @@
 #define __norcom2kv_app_h__
 
 #include <string>
+#include <list>
+#include <vector>
 #include <map>
+#include <set>
+#include <memory>
 #include "boost/date_time/posix_time/posix_time.hpp"
 #include "kvsubscribe/SendData.h"
-#include "kvsubscribe/HttpSendData.h"
 #include "kvalobs/kvbaseapp.h"
 #include "WMORaport.h"
 #include "FInfo.h"
@@ -45,6 +48,8 @@
 std::string fixPath( const std::string &path );
 std::string getDir( miutil::conf::ConfSection *conf, const char *key );
 
+class DeliveryQueue;
+class KvDelivery;
 
 
 class App : public KvBaseApp
@@ -54,7 +59,7 @@ public:
    typedef std::list<RaportDefValue> RaportDef;
 
 private:
-  std::string synopdir_;
+  std::list<std::string> synopdirs_;
   std::string workdir_;
   std::string tmpdir_;
   std::string data2kvdir_;
@@ -62,8 +67,28 @@ private:
   std::string logdir_;
   TKvDataSrcList refDataList;
   bool          debug_;
+  bool          useInotify_;
+  int           rescanInterval_;
+  bool          tailRead_;
+  int           quietPeriod_;
+  int           collectThreads_;
+  int           splitThreads_;
+  int           framingQueueSize_;
+  int           splitQueueSize_;
+  int           sendQueueSize_;
+  std::set<std::string> batchDecoders_;
+  int           batchSize_;
+  int           batchLingerMs_;
+  std::vector<int> sendTimeouts_;
+  int           kvserverConnections_;
+  int           sendWindow_;
+  int           breakerFailures_;
+  int           breakerCooldownMs_;
+  int           breakerMaxCooldownMs_;
+  int           maxRetries_;
   RaportDef  raports;
-  kvalobs::datasource::HttpSendData http;
+  std::unique_ptr<DeliveryQueue> queue;
+  std::list<std::unique_ptr<KvDelivery>> deliveries;
 
   void initLogger(const std::string &ll, const std::string &tl);
   void options(int argn, char **argv);
@@ -75,10 +100,28 @@ private:
   virtual ~App();
 
   /**
+   * Open the delivery queue in workdir and start the delivery to the
+   * kvservers. The messages that was not delivered when we was
+   * stopped is delivered first.
    *
-   * @throws When data can't be sent.
+   * \return false if the queue cant be opened.
    */
-  kvalobs::datasource::Result sendDataToKvalobs(const std::string &message, const std::string &obsType, std::string &sendtTo);
+  bool startDelivery();
+
+  /**
+   * Stop the delivery to the kvservers. The messages that is not
+   * delivered is kept in the queue.
+   */
+  void stopDelivery();
+
+  /**
+   * Add \a message to the delivery queue, it is delivered to each
+   * kvserver. It is durable when syncQueuedData returns. A \a priority
+   * message is sent ahead of the messages queued before it.
+   */
+  bool queueData(const std::string &message, const std::string &obsType,
+                 bool priority=false);
+  bool syncQueuedData();
 
    bool saveFInfoList(const std::string &name, const FInfoList &infoList);
    bool readFInfoList(const std::string &name, FInfoList &infoList);
@@ -90,6 +133,88 @@ private:
 
 	bool debug()const{ return debug_; }
 
+   /**
+    * Shall we use inotify to detect changes in the synopdir.
+    */
+   bool useInotify()const{ return useInotify_; }
+
+   /**
+    * The interval, in seconds, between full scans of the synopdir
+    * when inotify is in use.
+    */
+   int rescanInterval()const{ return rescanInterval_; }
+
+   /**
+    * Shall we read the new part of a file directly from the file,
+    * instead of reading all of it from a copy in tmpdir. It is off
+    * unless tail_read is set in the configuration.
+    */
+   bool tailRead()const{ return tailRead_; }
+
+   /**
+    * The time, in milliseconds, a file must be left unchanged before
+    * we regard the writer as done with it.
+    */
+   int quietPeriod()const{ return quietPeriod_; }
+
+   /**
+    * The number of threads that collects changed files in parallel.
+    * With 1 the files is collected one by one.
+    */
+   int collectThreads()const{ return collectThreads_; }
+
+   /**
+    * The number of threads that splits the bulletins in reports.
+    */
+   int splitThreads()const{ return splitThreads_; }
+
+   /**
+    * The capacity of the queues between the stages of the pipeline,
+    * the new observations from the files, the chunks of bulletins and
+    * the reports to send. When a queue is full the stage before it
+    * waits.
+    */
+   int framingQueueSize()const{ return framingQueueSize_; }
+   int splitQueueSize()const{ return splitQueueSize_; }
+   int sendQueueSize()const{ return sendQueueSize_; }
+
+   /**
+    * The decoders the reports is sent in batches to, many reports in
+    * one message.
+    */
+   const std::set<std::string> &batchDecoders()const{ return batchDecoders_; }
+
+   /**
+    * The max number of reports in a batch, and the max time, in
+    * milliseconds, the first report in a batch waits for more reports.
+    */
+   int batchSize()const{ return batchSize_; }
+   int batchLingerMs()const{ return batchLingerMs_; }
+
+   /**
+    * The number of connections to each kvserver, and the max number of
+    * messages in flight to a kvserver.
+    */
+   int kvserverConnections()const{ return kvserverConnections_; }
+   int sendWindow()const{ return sendWindow_; }
+
+   /**
+    * The circuit breaker for a kvserver. The sending to a kvserver
+    * stops for breakerCooldownMs when it has failed breakerFailures
+    * times in a row. The time is doubled, up to breakerMaxCooldownMs,
+    * while it is still down.
+    */
+   int breakerFailures()const{ return breakerFailures_; }
+   int breakerCooldownMs()const{ return breakerCooldownMs_; }
+   int breakerMaxCooldownMs()const{ return breakerMaxCooldownMs_; }
+
+   /**
+    * A message kvalobs did not save is given up when it has failed
+    * maxRetries times while kvalobs accepted other messages. It is
+    * saved in data2kvdir as kvfailed_*.
+    */
+   int maxRetries()const{ return maxRetries_; }
+
    /**
     * \brief Check if  \a dir is a directory! Exit if fail!!!
     *
@@ -117,7 +242,12 @@ private:
    std::string workdir()const { return workdir_; }
    std::string tmpdir()const {return tmpdir_;}
    std::string data2kvdir()const {return data2kvdir_;}
-   std::string synopdir()const{ return synopdir_;}
+
+   /**
+    * The directories to collect observations from. Each directory
+    * ends with a '/'.
+    */
+   std::list<std::string> synopdirs()const{ return synopdirs_;}
    wmoraport::WmoRaports getRaportsToCollect()const;
    std::string getDecoder( wmoraport::WmoRaport raportType ) const;
 };
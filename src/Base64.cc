@@ -0,0 +1,214 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include "Base64.h"
+
+#if defined( __x86_64__ ) || ( defined( __i386__ ) && defined( __SSE2__ ) )
+#define BASE64_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const char ALPHABET[]="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+char *
+encodeScalar( const char *in, size_t n, char *out )
+{
+	const unsigned char *p=reinterpret_cast<const unsigned char*>( in );
+	size_t i=0;
+
+	for( ; i + 3 <= n; i+=3 ) {
+		unsigned v=( p[i] << 16 ) | ( p[i+1] << 8 ) | p[i+2];
+		*out++=ALPHABET[v >> 18];
+		*out++=ALPHABET[( v >> 12 ) & 63];
+		*out++=ALPHABET[( v >> 6 ) & 63];
+		*out++=ALPHABET[v & 63];
+	}
+
+	if( n - i == 1 ) {
+		*out++=ALPHABET[p[i] >> 2];
+		*out++=ALPHABET[( p[i] & 3 ) << 4];
+		*out++='=';
+		*out++='=';
+	} else if( n - i == 2 ) {
+		*out++=ALPHABET[p[i] >> 2];
+		*out++=ALPHABET[( ( p[i] & 3 ) << 4 ) | ( p[i+1] >> 4 )];
+		*out++=ALPHABET[( p[i+1] & 15 ) << 2];
+		*out++='=';
+	}
+
+	return out;
+}
+
+#ifdef BASE64_KERNELS_X86
+
+//The vector encoding is the one by Wojciech Muła and Daniel Lemire.
+//The 3 bytes of each group is shuffled to 4 bytes, the 4 sextets is
+//moved in place with multiplications, and the sextets is mapped to
+//the alphabet by adding an offset looked up from the range of the
+//sextet.
+
+__attribute__(( target( "ssse3" ) )) inline __m128i
+encode12( __m128i in )
+{
+	in=_mm_shuffle_epi8( in, _mm_set_epi8( 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1 ) );
+	__m128i t0=_mm_mulhi_epu16( _mm_and_si128( in, _mm_set1_epi32( 0x0fc0fc00 ) ),
+			_mm_set1_epi32( 0x04000040 ) );
+	__m128i t1=_mm_mullo_epi16( _mm_and_si128( in, _mm_set1_epi32( 0x003f03f0 ) ),
+			_mm_set1_epi32( 0x01000010 ) );
+	__m128i sextets=_mm_or_si128( t0, t1 );
+
+	//0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12.
+	__m128i range=_mm_subs_epu8( sextets, _mm_set1_epi8( 51 ) );
+	range=_mm_or_si128( range, _mm_and_si128(
+			_mm_cmpgt_epi8( _mm_set1_epi8( 26 ), sextets ), _mm_set1_epi8( 13 ) ) );
+	__m128i offsets=_mm_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+			'/' - 63, 'A', 0, 0 );
+
+	return _mm_add_epi8( sextets, _mm_shuffle_epi8( offsets, range ) );
+}
+
+__attribute__(( target( "ssse3" ) )) char *
+encodeSSSE3( const char *in, size_t n, char *out )
+{
+	size_t i=0;
+
+	//Reads 16 bytes to encode 12.
+	for( ; i + 16 <= n; i+=12, out+=16 )
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( out ), encode12(
+				_mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i ) ) ) );
+
+	return encodeScalar( in + i, n - i, out );
+}
+
+__attribute__(( target( "avx2" ) )) char *
+encodeAVX2( const char *in, size_t n, char *out )
+{
+	const __m256i shuffle=_mm256_set_epi8(
+			10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+			10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1 );
+	const __m256i offsets=_mm256_setr_epi8(
+			'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+			'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0 );
+	size_t i=0;
+
+	//The shuffles is within the 128 bit lanes, so each lane is loaded
+	//with 16 bytes to encode 12 of them. Reads 28 bytes to encode 24.
+	for( ; i + 28 <= n; i+=24, out+=32 ) {
+		__m256i x=_mm256_inserti128_si256( _mm256_castsi128_si256(
+				_mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i ) ) ),
+				_mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i + 12 ) ), 1 );
+		x=_mm256_shuffle_epi8( x, shuffle );
+		__m256i t0=_mm256_mulhi_epu16( _mm256_and_si256( x, _mm256_set1_epi32( 0x0fc0fc00 ) ),
+				_mm256_set1_epi32( 0x04000040 ) );
+		__m256i t1=_mm256_mullo_epi16( _mm256_and_si256( x, _mm256_set1_epi32( 0x003f03f0 ) ),
+				_mm256_set1_epi32( 0x01000010 ) );
+		__m256i sextets=_mm256_or_si256( t0, t1 );
+		__m256i range=_mm256_subs_epu8( sextets, _mm256_set1_epi8( 51 ) );
+		range=_mm256_or_si256( range, _mm256_and_si256(
+				_mm256_cmpgt_epi8( _mm256_set1_epi8( 26 ), sextets ), _mm256_set1_epi8( 13 ) ) );
+		_mm256_storeu_si256( reinterpret_cast<__m256i*>( out ),
+				_mm256_add_epi8( sextets, _mm256_shuffle_epi8( offsets, range ) ) );
+	}
+
+	return encodeSSSE3( in + i, n - i, out );
+}
+
+#endif
+
+struct Encoder {
+	const char *name;
+	char *( *encode )( const char *in, size_t n, char *out );
+};
+
+const Encoder scalarEncoder={ "scalar", encodeScalar };
+#ifdef BASE64_KERNELS_X86
+const Encoder ssse3Encoder={ "ssse3", encodeSSSE3 };
+const Encoder avx2Encoder={ "avx2", encodeAVX2 };
+#endif
+
+//Is constant initialized, so the scalar encoder is used if it is
+//called before the encoder is chosen.
+const Encoder *encoder=&scalarEncoder;
+
+const Encoder *
+findEncoder( const char *name )
+{
+	if( ! name || strcmp( name, "scalar" ) == 0 )
+		return &scalarEncoder;
+
+#ifdef BASE64_KERNELS_X86
+	__builtin_cpu_init();
+
+	if( strcmp( name, "ssse3" ) == 0 && __builtin_cpu_supports( "ssse3" ) )
+		return &ssse3Encoder;
+
+	if( strcmp( name, "avx2" ) == 0 && __builtin_cpu_supports( "avx2" ) )
+		return &avx2Encoder;
+#endif
+
+	return 0;
+}
+
+const bool encoderChosen=wmoraport::useBase64Kernels( "avx2" ) ||
+                         wmoraport::useBase64Kernels( "ssse3" );
+
+}
+
+namespace wmoraport {
+
+char *
+encodeBase64( const char *in, size_t n, char *out )
+{
+	return encoder->encode( in, n, out );
+}
+
+const char *
+base64Kernels()
+{
+	return encoder->name;
+}
+
+bool
+useBase64Kernels( const char *name )
+{
+	const Encoder *e=findEncoder( name );
+
+	if( ! e )
+		return false;
+
+	encoder=e;
+	return true;
+}
+
+}
@@ -0,0 +1,74 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __Base64_h__
+#define __Base64_h__
+
+#include <stddef.h>
+
+namespace wmoraport {
+
+/**
+ * The size of \a n bytes base64 encoded, with padding.
+ */
+inline size_t
+base64Size( size_t n )
+{
+	return ( n + 2 ) / 3 * 4;
+}
+
+/**
+ * Base64 encode the \a n bytes at \a in to \a out, with the standard
+ * alphabet and '=' padding and without line breaks. The result is the
+ * same as from miutil::encode64.
+ *
+ * \a out must have room for base64Size(n) characters.
+ *
+ * The bytes is encoded 24 or 12 at a time with AVX2 or SSSE3, the best
+ * version the CPU supports is chosen at startup.
+ *
+ * \return The end of the encoded characters.
+ */
+char *encodeBase64( const char *in, size_t n, char *out );
+
+/**
+ * The name of the encoder in use, "avx2", "ssse3" or "scalar".
+ */
+const char *base64Kernels();
+
+/**
+ * Use the encoder \a name, "avx2", "ssse3" or "scalar", instead of the
+ * one chosen at startup. Used to compare them.
+ *
+ * \return false if the CPU do not support it.
+ */
+bool useBase64Kernels( const char *name );
+
+}
+
+#endif
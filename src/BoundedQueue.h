@@ -0,0 +1,196 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __BoundedQueue_h__
+#define __BoundedQueue_h__
+
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+/**
+ * A bounded multi producer, multi consumer queue.
+ *
+ * tryPush and tryPop is lock free. The queue is a ring of cells
+ * where each cell has a sequence number that tells if it is free
+ * to be written or read in the current lap of the ring.
+ *
+ * push and pop blocks while the queue is full or empty, with
+ * std::atomic::wait, until the queue is closed. A producer that is
+ * blocked by a full queue is how a slow stage slows down the
+ * stages before it.
+ */
+template<class T>
+class BoundedQueue
+{
+	BoundedQueue(const BoundedQueue&);
+	BoundedQueue& operator=(const BoundedQueue&);
+
+	struct Cell {
+		std::atomic<size_t> seq;
+		T                   data;
+	};
+
+	std::unique_ptr<Cell[]> cells_;
+	size_t                  mask_;
+	alignas(64) std::atomic<size_t> enqueuePos_;
+	alignas(64) std::atomic<size_t> dequeuePos_;
+	alignas(64) std::atomic<unsigned> pushed_; //Changed for every push, to wake consumers.
+	alignas(64) std::atomic<unsigned> popped_; //Changed for every pop, to wake producers.
+	std::atomic<bool> closed_;
+
+public:
+	/**
+	 * \param capacity The max number of elements in the queue. It is
+	 *        rounded up to a power of 2.
+	 */
+	explicit BoundedQueue(size_t capacity)
+		:enqueuePos_(0), dequeuePos_(0), pushed_(0), popped_(0), closed_(false)
+	{
+		size_t size=2;
+
+		while(size<capacity)
+			size*=2;
+
+		cells_.reset(new Cell[size]);
+		mask_=size-1;
+
+		for(size_t i=0; i<size; i++)
+			cells_[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	size_t capacity()const{ return mask_+1;}
+
+	bool tryPush(T &value){
+		Cell   *cell;
+		size_t pos=enqueuePos_.load(std::memory_order_relaxed);
+
+		for(;;){
+			cell=&cells_[pos & mask_];
+			size_t seq=cell->seq.load(std::memory_order_acquire);
+			long   dif=static_cast<long>(seq)-static_cast<long>(pos);
+
+			if(dif==0){
+				if(enqueuePos_.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+					break;
+			}else if(dif<0){
+				return false; //Full
+			}else{
+				pos=enqueuePos_.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->data=std::move(value);
+		cell->seq.store(pos+1, std::memory_order_release);
+		pushed_.fetch_add(1, std::memory_order_release);
+		pushed_.notify_all();
+		return true;
+	}
+
+	bool tryPop(T &value){
+		Cell   *cell;
+		size_t pos=dequeuePos_.load(std::memory_order_relaxed);
+
+		for(;;){
+			cell=&cells_[pos & mask_];
+			size_t seq=cell->seq.load(std::memory_order_acquire);
+			long   dif=static_cast<long>(seq)-static_cast<long>(pos+1);
+
+			if(dif==0){
+				if(dequeuePos_.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+					break;
+			}else if(dif<0){
+				return false; //Empty
+			}else{
+				pos=dequeuePos_.load(std::memory_order_relaxed);
+			}
+		}
+
+		value=std::move(cell->data);
+		cell->data=T();
+		cell->seq.store(pos+mask_+1, std::memory_order_release);
+		popped_.fetch_add(1, std::memory_order_release);
+		popped_.notify_all();
+		return true;
+	}
+
+	/**
+	 * Push \a value, wait while the queue is full.
+	 *
+	 * \return false if the queue is closed. value is then unchanged.
+	 */
+	bool push(T &value){
+		for(;;){
+			if(closed_.load(std::memory_order_acquire))
+				return false;
+
+			unsigned popped=popped_.load(std::memory_order_acquire);
+
+			if(tryPush(value))
+				return true;
+
+			popped_.wait(popped, std::memory_order_acquire);
+		}
+	}
+
+	/**
+	 * Pop a value, wait while the queue is empty.
+	 *
+	 * \return false if the queue is closed and empty.
+	 */
+	bool pop(T &value){
+		for(;;){
+			unsigned pushed=pushed_.load(std::memory_order_acquire);
+
+			if(tryPop(value))
+				return true;
+
+			if(closed_.load(std::memory_order_acquire))
+				return tryPop(value);
+
+			pushed_.wait(pushed, std::memory_order_acquire);
+		}
+	}
+
+	/**
+	 * Close the queue. Nothing more can be pushed, and the consumers
+	 * return from pop when the queue is empty.
+	 */
+	void close(){
+		closed_.store(true, std::memory_order_release);
+		pushed_.fetch_add(1, std::memory_order_release);
+		popped_.fetch_add(1, std::memory_order_release);
+		pushed_.notify_all();
+		popped_.notify_all();
+	}
+
+	bool closed()const{ return closed_.load(std::memory_order_acquire);}
+};
+
+#endif
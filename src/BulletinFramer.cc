@@ -0,0 +1,243 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include "BulletinFramer.h"
+
+namespace {
+inline bool
+isCRLF( char ch )
+{
+	return ch == '\r' || ch == '\n';
+}
+
+inline bool
+isZCZCLineChar( char ch )
+{
+	return ch == ' ' || ( ch >= '0' && ch <= '9' ) || isCRLF( ch );
+}
+}
+
+namespace wmoraport {
+
+bool
+BulletinFramer::
+findZCZC( Bulletin &b, bool &lineOk )
+{
+	const char *ZCZC="ZCZC";
+	const char *p=buf_.data();
+	const size_t n=buf_.size();
+	size_t i=pos_;
+	int izc=0;
+
+	//A character that breaks a partial match is not tried as the
+	//start of a new match. ie. 'ZZCZC' is not a ZCZC. This is how
+	//it always has been.
+	while( izc < 4 ) {
+		if( izc == 0 ) {
+			const char *z=static_cast<const char*>( memchr( p+i, 'Z', n-i ) );
+
+			if( ! z ) {
+				pos_=n;
+				return false;
+			}
+
+			i=z-p;
+		}
+
+		if( i >= n ) {
+			pos_=n;
+			return false;
+		}
+
+		if( p[i++] == ZCZC[izc] )
+			++izc;
+		else
+			izc=0;
+	}
+
+	b.zczcBegin=i-4;
+
+	while( i < n && isZCZCLineChar( p[i] ) )
+		++i;
+
+	//A ZCZC line that runs to the end of the buffer has no bulletin.
+	if( i >= n ) {
+		pos_=n;
+		return false;
+	}
+
+	lineOk = ( i > b.zczcBegin+4 && p[i-1] == '\n' );
+	b.begin=i;
+	b.zczcEnd=i;
+
+	while( b.zczcEnd > b.zczcBegin+4 &&
+			( p[b.zczcEnd-1] == ' ' || isCRLF( p[b.zczcEnd-1] ) ) )
+		--b.zczcEnd;
+
+	pos_=i;
+	return true;
+}
+
+bool
+BulletinFramer::
+findNNNN( Bulletin &b )
+{
+	const char *p=buf_.data();
+	const size_t n=buf_.size();
+	size_t k=b.begin;
+
+	while( k < n ) {
+		const char *q=static_cast<const char*>( memmem( p+k, n-k, "NNNN", 4 ) );
+
+		if( ! q ) {
+			pos_=n;
+			return false;
+		}
+
+		//The state of the match of the end mark is reset by any
+		//character that is not N, CR or LF. Go back to the start of
+		//the run of N, CR and LF the NNNN is in, and follow the run
+		//byte by byte.
+		size_t t=q-p;
+
+		while( t > k && ( p[t-1] == 'N' || isCRLF( p[t-1] ) ) )
+			--t;
+
+		size_t count=0;
+		int iNNN=0;
+		int rnCount=0;
+
+		for( ; t < n; ++t ) {
+			char ch=p[t];
+
+			if( ch == 'N' && iNNN < 4 ) {
+				++count;
+				++iNNN;
+			} else if( isCRLF( ch ) ) {
+				++count;
+				++rnCount;
+				iNNN=0;
+			} else {
+				break;
+			}
+
+			if( iNNN == 4 && rnCount > 2 )
+				break;
+		}
+
+		if( t >= n ) {
+			pos_=n;
+			return false;
+		}
+
+		if( iNNN != 4 || rnCount <= 2 ) {
+			//Not an end mark. The character at t resets the match,
+			//continue after it.
+			k=t+1;
+			continue;
+		}
+
+		//Found NNNN, the rest of the line must be CR/LF.
+		char prevCh=p[t];
+		rnCount=0;
+
+		for( ++t; ; ++t ) {
+			if( t >= n ) {
+				pos_=n;
+
+				if( rnCount == 0 )
+					return false;
+
+				b.end=n-count;
+				return true;
+			}
+
+			if( prevCh == '\n' && rnCount > 0 ) {
+				pos_=t;
+				b.end=t-count;
+				return true;
+			}
+
+			if( ! isCRLF( p[t] ) ) {
+				pos_=t+1;
+				return false;
+			}
+
+			++rnCount;
+			++count;
+			prevCh=p[t];
+		}
+	}
+
+	pos_=n;
+	return false;
+}
+
+bool
+BulletinFramer::
+next( Bulletin &b )
+{
+	bool lineOk;
+
+	while( pos_ < buf_.size() ) {
+		if( ! findZCZC( b, lineOk ) )
+			return false;
+
+		if( ! lineOk )
+			continue;
+
+		if( findNNNN( b ) )
+			return true;
+	}
+
+	return false;
+}
+
+void
+frameBulletins( std::string_view raport, size_t minSize,
+                std::vector<std::string_view> &chunks )
+{
+	BulletinFramer framer( raport );
+	Bulletin b;
+	size_t start=0;
+
+	chunks.clear();
+
+	while( framer.next( b ) ) {
+		if( b.zczcBegin - start >= minSize && b.zczcBegin > start ) {
+			chunks.push_back( raport.substr( start, b.zczcBegin - start ) );
+			start=b.zczcBegin;
+		}
+	}
+
+	if( start < raport.size() )
+		chunks.push_back( raport.substr( start ) );
+}
+
+}
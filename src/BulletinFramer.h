@@ -0,0 +1,120 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __BulletinFramer_h__
+#define __BulletinFramer_h__
+
+#include <stddef.h>
+#include <string_view>
+#include <vector>
+
+namespace wmoraport {
+
+/**
+ * The position of a bulletin in a buffer, as offsets from the start
+ * of the buffer.
+ */
+struct Bulletin {
+	size_t zczcBegin; ///< The ZCZC line, without trailing white space.
+	size_t zczcEnd;
+	size_t begin;     ///< The bulletin, after the ZCZC line and without
+	size_t end;       ///< the end mark (NNNN).
+};
+
+/**
+ * Find the bulletins in a contiguous buffer.
+ *
+ * A bulletin starts with the line 'ZCZC nnn' and ends with the end mark,
+ * at least three CR/LF, NNNN and CR/LF up to and including a LF, ie.
+ * '\\r\\r\\nNNNN\\r\\r\\n'. The bytes is not copied, the bulletins is
+ * returned as offsets into the buffer.
+ *
+ * The start and end marks is found as the old istream based
+ * WMORaport::getMessage found them, also in malformed input. The text
+ * between ZCZC and the end mark is searched for with memchr and memmem,
+ * and only the short runs of N, CR and LF around a NNNN is looked at
+ * byte by byte.
+ */
+class BulletinFramer
+{
+	std::string_view buf_;
+	size_t           pos_;
+
+	/**
+	 * Find the next ZCZC line from pos_.
+	 *
+	 * \return false if there is no more ZCZC. Otherwise b.zczcBegin,
+	 *         b.zczcEnd and b.begin is set. \a lineOk is false if the
+	 *         ZCZC line is not terminated by a LF.
+	 */
+	bool findZCZC( Bulletin &b, bool &lineOk );
+
+	/**
+	 * Find the end mark of the bulletin that starts at b.begin. pos_ is
+	 * set to where the search for the next bulletin continues.
+	 *
+	 * \return false if the bulletin has no valid end mark.
+	 */
+	bool findNNNN( Bulletin &b );
+
+public:
+	explicit BulletinFramer( std::string_view buf )
+		: buf_( buf ), pos_( 0 ) {}
+
+	/**
+	 * Find the next bulletin.
+	 *
+	 * \return false when there is no more bulletins in the buffer.
+	 */
+	bool next( Bulletin &b );
+
+	std::string_view zczcLine( const Bulletin &b )const {
+		return buf_.substr( b.zczcBegin, b.zczcEnd - b.zczcBegin );
+	}
+
+	std::string_view body( const Bulletin &b )const {
+		return buf_.substr( b.begin, b.end - b.begin );
+	}
+};
+
+/**
+ * Cut \a raport in chunks of whole bulletins, so the chunks can be
+ * split independent of each other. A chunk is at least \a minSize
+ * bytes, except the last one.
+ *
+ * A chunk is only cut in front of the ZCZC of a bulletin that
+ * BulletinFramer finds, WMORaport::split then finds the same bulletins
+ * in the chunks as in all of \a raport.
+ *
+ * \param[out] chunks Views into \a raport.
+ */
+void frameBulletins( std::string_view raport, size_t minSize,
+                     std::vector<std::string_view> &chunks );
+}
+
+#endif
@@ -32,26 +32,29 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
 #include <milog/milog.h>
-#include <fileutil/dir.h>
-#include <fileutil/copyfile.h>
 #include "CollectWmoReports.h"
-#include "crc_ccitt.h"
+#include "BulletinFramer.h"
+#include "GtsHeader.h"
 #include <puTools/miTime.h>
 
 using namespace std;
 using namespace miutil;
-using kvalobs::datasource::Result;
 extern string progname;
 
 CollectWmoReports::CollectWmoReports(App &app_)
-:app(app_), ignoreFilesBefore( app.ignoreFilesBeforeStartup )
+:app(app_), ignoreFilesBefore( app.ignoreFilesBeforeStartup ),
+ framingQueue(app.framingQueueSize()), splitQueue(app.splitQueueSize()),
+ sendQueue(app.sendQueueSize()),
+ prioritySendQueue(app.sendQueueSize()), nextChunk(0)
 {
 
 }
@@ -102,191 +105,179 @@ CollectWmoReports::getFileList(FileList &fileList,
 		const std::string &path_,
 		const std::string &pattern)
 {
-	dnmi::file::Dir   dir;
-	string            file;
-	string            path(path_);
-	string            filepath;
-	struct stat       sbuf;
-	File              f;
-	boost::posix_time::ptime ftime;
-
-	fileList.clear();
+	string path(path_);
 
 	if(path.empty()){
 		LOGERROR("getFileList: path is empty!!!!");
+		fileList.clear();
 		return false;
 	}
 	path = fixPath(path);
 
-	if(!dir.open(path, pattern)){
-		LOGERROR("Cant read directory <" << path << ">!");
+	if(!scanner.scan(path, pattern, fileList)){
+		LOGERROR("Cant read directory <" << path << ">! " << scanner.error());
 		return false;
 	}
 
-	//LOGDEBUG("Scan the directory: " << path << endl <<
-	//	   "Pattern: <" << (pattern.empty()?"*":pattern)
-	//	   << ">");
-
-	while(dir.hasNext()){
-		file=dir.next();
+	if(!ignoreFilesBefore.is_neg_infinity()){
+		fileList.erase(std::remove_if(fileList.begin(), fileList.end(),
+				[this](const File &f){
+					return boost::posix_time::from_time_t(f.mtime()) < ignoreFilesBefore;
+				}),
+				fileList.end());
+	}
 
-		if(file==".." || file==".")
-			continue;
+	return !fileList.empty();
+}
 
-		filepath=path;
-		filepath+=file;
 
-		if(stat(filepath.c_str(), &sbuf)<0){
-			LOGERROR("Cant get modification time for the file <" <<
-					filepath << ">!");
-			continue;
-		}
 
-		ftime = boost::posix_time::from_time_t( sbuf.st_mtime );
+int 
+CollectWmoReports::run()
+{
+	const  int RESEND_DELAY=60;
+	time_t  tNow;
+	time_t  savedObsCheckTime=0;
+	std::list<std::string> dirs=app.synopdirs();
+	FInfoList infoList;
+	int       n=0;
 
-		if( ftime < ignoreFilesBefore )
-			continue;
+	if(dirs.empty()){
+		LOGFATAL("No SYNOP directory is given!");
+		return 1;
+	}
 
-		f=File(filepath, sbuf);
+	if(!app.startDelivery()){
+		LOGFATAL("Cant open the delivery queue in <" << app.workdir() << ">!");
+		return 1;
+	}
 
-		if(!f.isFile())
-			continue;
+	stateFile=app.workdir() + progname + "_finfo.dat";
+	LOGINFO("CollectWmoReports: State file '" << stateFile << "'.");
 
-		fileList.push_back(f);
-	}
+	app.readFInfoList( stateFile, infoList);
 
-	return !fileList.empty();
-}
+	//Give each directory the part of the state file for the files
+	//in it. Files in directories that is no longer in synopdir is dropped.
+	for(IFInfoList it=infoList.begin(); it!=infoList.end(); it++){
+		string::size_type i=it->first.find_last_of("/");
 
+		if(i!=string::npos && std::find(dirs.begin(), dirs.end(),
+				it->first.substr(0, i+1))!=dirs.end())
+			stateShards[it->first.substr(0, i+1)].insert(*it);
+	}
 
+	if(app.collectThreads()>1){
+		LOGINFO("CollectWmoReports: Collecting files with " << app.collectThreads() << " threads.");
+		pool=std::make_unique<WorkerPool>(app.collectThreads());
+	}
 
-/**
- * returns true if the file could be received by kvalobs and
- *         is saved i the databse. false otherwise.
- */
+	BOOST_FOREACH(const std::string &dir, dirs){
+		ostringstream tmpPrefix;
 
-bool
-CollectWmoReports::sendMessageToKvalobs(const std::string &msg,
-		const std::string &obsType,
-		bool &kvServerIsUp,
-		bool &tryToResend)const
-{
-	string sendtTo;
-	Result res;
+		//The copies in tmpdir from the first directory keeps the
+		//names they had when there was only one directory.
+		if(n>0)
+			tmpPrefix << "d" << n << "_";
 
-	try {
-	  res=app.sendDataToKvalobs(msg, obsType, sendtTo);
-	}
-	catch(const std::exception &x){
-		kvServerIsUp=false;
-		tryToResend=true;
-		LOGERROR("Cant connect to kvalobs. Is kvalobs running?" << endl <<
-				"Tryed to send to: " << sendtTo);
-		return false;
+		n++;
+		collectors.push_back(std::make_unique<DirCollector>(app, *this, pool.get(), dir,
+				tmpPrefix.str(), stateShards[dir]));
 	}
 
-	LOGINFO("Sendt to servers: " << sendtTo);
+	LOGINFO("CollectWmoReports: Splitting with " << app.splitThreads() << " threads.");
 
-	kvServerIsUp=true;
+	framer=std::thread(&CollectWmoReports::frameObservations, this);
 
-	if(res.res==kvalobs::datasource::OK){
-		tryToResend=false;
-		return true;
-	}else if(res.res==kvalobs::datasource::NOTSAVED){
-		tryToResend=true;
-		LOGERROR("kvalobs NOTSAVED: " <<res.message);
-	}else if(res.res==kvalobs::datasource::ERROR){
-		LOGERROR("kvalobs ERROR: " << res.message);
-		tryToResend=true;
-	}else if(res.res==kvalobs::datasource::NODECODER){
-		LOGERROR("kvalobs NODECODER: " << res.message);
-		tryToResend=false;
-	}else  if(res.res==kvalobs::datasource::DECODEERROR){
+	for(int i=0; i<app.splitThreads(); i++)
+		splitters.push_back(std::thread(&CollectWmoReports::splitObservations, this));
 
-		string msg(res.message);
-		string::size_type i=msg.find("unknown station/position");
+	queuer=std::thread(&CollectWmoReports::queueObservations, this);
 
-		if( i == string::npos )
-			i = msg.find("Missing or unknown stationid!");
+	BOOST_FOREACH(std::unique_ptr<DirCollector> &collector, collectors){
+		collector->start();
+	}
 
-		tryToResend=false;
+	while(!app.inShutdown()){
+		time(&tNow);
 
-		//Dont log Unknown station/position. Treat it as a
-		//successfull transmit to kvalobs!
-		if(i!=string::npos)
-			return true;
+		if((tNow-savedObsCheckTime)>=RESEND_DELAY){
+			savedObsCheckTime=tNow;
+			queueSavedObservations();
+		}
 
-		LOGERROR("kvalobs DECODEERROR (rejected): " << res.message);
-	}else{
-		LOGERROR("kvalobs Unknown response from kvalobs. Check if the code is in sync"
-				<< " with 'datasource.idl'!");
-		tryToResend=false;
+		sleep(1);
 	}
 
+	BOOST_FOREACH(std::unique_ptr<DirCollector> &collector, collectors){
+		collector->join();
+	}
 
-	return false;
-}
+	//Drain the pipeline, stage by stage.
+	framingQueue.close();
+	framer.join();
 
-int 
-CollectWmoReports::run()
-{
-	const  int DELAY=3;
-	const  int RESEND_DELAY=60;
-	time_t  tNow;
-	time_t  newObsCheckTime=0;
-	time_t  savedObsCheckTime=0;
-	bool    doSleep=true;
+	splitQueue.close();
 
-	if(app.synopdir().empty()){
-		LOGFATAL("No SYNOP directory is given!");
-		return 1;
+	BOOST_FOREACH(std::thread &t, splitters){
+		t.join();
 	}
 
-	std::string stateFile(app.workdir() + progname + "_finfo.dat");
-	LOGINFO("CollectWmoReports: State file '" << stateFile << "'.");
-
-	app.readFInfoList( stateFile, fileInfoList);
+	sendQueue.close();
+	prioritySendQueue.close();
+	queuer.join();
 
-	while(!app.inShutdown()){
-		time(&tNow);
-		doSleep=true;
+	app.stopDelivery();
 
-		if((tNow-newObsCheckTime)>=DELAY){
-			newObsCheckTime=tNow;
-			doSleep=false;
+	LOGDEBUG("Return from CollectSynop!");
+	return 0;
+}
 
-			if(checkForNewObservations()){
-				collectObservations();
-				app.saveFInfoList( stateFile,	fileInfoList);
+void
+CollectWmoReports::saveFInfoList(const std::string &dir, const FInfoList &fileInfoList)
+{
+	ObsChunk chunk;
 
-			}
-		}
+	chunk.state=std::make_shared<DirState>();
+	chunk.state->dir=dir;
+	chunk.state->infoList=fileInfoList;
 
-		if((tNow-savedObsCheckTime)>=RESEND_DELAY){
-			savedObsCheckTime=tNow;
-			tryToSendSavedObservations();
-			doSleep=false;
-		}
+	//The state follows the new observations from the directory through
+	//the pipeline.
+	if(!framingQueue.push(chunk)){
+		LOGERROR("The pipeline is closed, the state of <" << dir << "> is not saved.");
+	}
+}
 
-		if(doSleep)
-			sleep(1);
+void
+CollectWmoReports::saveState(const DirState &state)
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
 
+	if(collectors.size()==1){
+		app.saveFInfoList(stateFile, state.infoList);
+		return;
 	}
 
-	LOGDEBUG("Return from CollectSynop!");
-	return 0;
+	FInfoList infoList;
+	stateShards[state.dir]=state.infoList;
+
+	for(std::map<std::string, FInfoList>::const_iterator it=stateShards.begin();
+			it!=stateShards.end(); it++)
+		infoList.insert(it->second.begin(), it->second.end());
+
+	app.saveFInfoList(stateFile, infoList);
 }
 
 void
-CollectWmoReports::tryToSendSavedObservations()
+CollectWmoReports::queueSavedObservations()
 {
 	FileList  fileList;
 	IFileList it;
 	string    content;
 	string::size_type i;
 	string    type;
-	bool      kvServerIsUp;
-	bool      tryToResend;
+	std::vector<std::string> queued;
 
 	if(!getFileList(fileList, app.data2kvdir(),"kvdata_*")){
 		//LOGDEBUG("No saved observations!");
@@ -295,6 +286,10 @@ CollectWmoReports::tryToSendSavedObservations()
 
 	LOGDEBUG("# saved obs: " << fileList.size());
 
+	if(app.test()){
+		return;
+	}
+
 	for(it=fileList.begin();
 			it!=fileList.end() && !app.inShutdown();
 			it++){
@@ -324,87 +319,295 @@ CollectWmoReports::tryToSendSavedObservations()
 
 		content.erase(0, i+1);
 
-		if(app.test()){
-			return;
+		if(!app.queueData(content, type)){
+			LOGERROR("Cant queue saved observation." << endl
+					<<"Will try later!");
+			break;
 		}
 
-		if(!sendMessageToKvalobs(content, type, kvServerIsUp, tryToResend)){
+		queued.push_back(it->name());
+	}
 
-			if(!tryToResend){
-				LOGERROR("SAVEDOBS, kvalobs 'says' I should delete the observation.");
-				unlink(it->name().c_str());
-			}else{
-				LOGERROR("Cant send saved observation to kvalobs." << endl
-						<<"Will try to send later!");
-			}
+	//The local copies is deleted when the queue has them.
+	if(queued.empty() || !app.syncQueuedData())
+		return;
+
+	BOOST_FOREACH(const std::string &file, queued){
+		LOGINFO("Queued the saved observation. Delete local copy: " << file);
+		unlink(file.c_str());
+	}
+}
+
+void
+CollectWmoReports::doNewObs(const std::string &obsFileName, std::string_view obs)
+{
+	doNewObs(obsFileName, std::string(obs));
+}
+
+void
+CollectWmoReports::doNewObs(const std::string &obsFileName, std::string &&obs)
+{
+	ObsChunk newObs;
+
+	newObs.file=obsFileName;
+	newObs.obs=std::move(obs);
 
+	//Blocks while the framing stage is behind.
+	if(!framingQueue.push(newObs)){
+		LOGERROR("The pipeline is closed, the new observations in <"
+				<< obsFileName << "> is lost.");
+	}
+}
+
+void
+CollectWmoReports::frameObservations()
+{
+	//The bulletins in a file is split in chunks of about this size,
+	//so the splitting and sending of a large file overlaps.
+	const size_t CHUNK_SIZE=64*1024;
+	ObsChunk newObs;
+	ObsChunk chunk;
+	std::vector<std::string_view> chunks;
+	unsigned long long seq=0;
+
+	while(framingQueue.pop(newObs)){
+		if(newObs.state){
+			newObs.seq=seq++;
+			splitQueue.push(newObs);
+			continue;
+		}
+
+		wmoraport::frameBulletins(newObs.obs, CHUNK_SIZE, chunks);
 
-			//Can't send the observation to kvalobs.
-			//Just break out of loop.
-			if(!kvServerIsUp)
-				break;
+		if(chunks.size()==1){
+			newObs.seq=seq++;
+			splitQueue.push(newObs);
+			continue;
+		}
+
+		BOOST_FOREACH(std::string_view c, chunks){
+			chunk.file=newObs.file;
+			chunk.obs.assign(c);
+			chunk.seq=seq++;
+			splitQueue.push(chunk);
+		}
+	}
+}
+
+void
+CollectWmoReports::splitObservations()
+{
+	ObsChunk chunk;
+	std::vector<KvMessage> msgs;
+
+	while(splitQueue.pop(chunk)){
+		msgs.clear();
+
+		if(chunk.state){
+			msgs.emplace_back();
+			msgs.back().state=chunk.state;
+			chunk.state.reset();
 		}else{
-			LOGINFO("Kvalobs got the observation. Delete local copy!");
-			unlink(it->name().c_str());
+			splitChunk(chunk.file, chunk.obs, msgs);
 		}
+
+		mergeChunk(chunk.seq, msgs);
 	}
 }
 
 void
-CollectWmoReports::collectObservations()
+CollectWmoReports::mergeChunk(unsigned long long seq, std::vector<KvMessage> &msgs)
 {
-	IFInfoList it;
-	std::string buf;
-	std::string newObsPart;
+	std::lock_guard<std::mutex> lock(mergeMutex);
 
-	LOGINFO("New observations to collect!");
+	if(seq!=nextChunk){
+		mergeChunks[seq].swap(msgs);
+		return;
+	}
 
-	it=fileInfoList.begin();
+	//Queue the reports from this chunk and the chunks after it
+	//that is waiting. The other splitters wait for the lock while
+	//the queuer is behind.
+	for(;;){
+		BOOST_FOREACH(KvMessage &msg, msgs){
+			queueReport(msg);
+		}
 
-	for(;it!=fileInfoList.end() && !app.inShutdown(); it++){
-		if(it->second.toBeCollected()){
-			string fromfile(it->second.copy());
+		nextChunk++;
+		std::map<unsigned long long, std::vector<KvMessage>>::iterator it=
+				mergeChunks.find(nextChunk);
 
-			LOGINFO("Collect file: " << it->first << endl <<
-					"From the copy: " << fromfile);
+		if(it==mergeChunks.end())
+			break;
 
-			if(!readFile(fromfile, buf)){
-				LOGERROR("Can't read the file: " << fromfile);
+		msgs.swap(it->second);
+		mergeChunks.erase(it);
+	}
+}
 
-				if(!app.debug())
-					unlink(fromfile.c_str());
+void
+CollectWmoReports::queueObservations()
+{
+	KvMessage msg;
 
-				it->second.seen(false);
-				it->second.collected(false);
-				continue;
-			}
+	for(;;){
+		while(prioritySendQueue.tryPop(msg))
+			queueObservation(msg);
 
-			File f(fromfile);
+		if(!sendQueue.pop(msg))
+			break;
 
-			if(!f.ok()){
-				LOGERROR("Cant stat the file: " << fromfile );
+		if(!msg.state){
+			queueObservation(msg);
+			continue;
+		}
 
-				it->second.removecopy(!app.debug());
+		//The priority reports from the observations before the state
+		//may still be in prioritySendQueue.
+		while(prioritySendQueue.tryPop(msg))
+			queueObservation(msg);
 
-				it->second.seen(false);
-				it->second.collected(false);
-				continue;
-			}
+		if(app.syncQueuedData())
+			saveState(*msg.state);
+		else
+			LOGERROR("Cant sync the delivery queue, the state of <" << msg.state->dir << "> is not saved.");
 
-			it->second.removecopy(!app.debug());
+		msg.state.reset();
+	}
 
-			newObsPart=getNewObsPart(buf, it);
-			it->second.collected(true);
+	while(prioritySendQueue.tryPop(msg))
+		queueObservation(msg);
 
-			if(!newObsPart.empty()){
-				doNewObs(it->first, newObsPart);
-			}
-		}
+	app.syncQueuedData();
+}
+
+void
+CollectWmoReports::queueObservation(const KvMessage &msg)
+{
+	if(msg.decoder.empty())
+		return;
+
+	if(!app.queueData(msg.msg, msg.decoder, msg.priority)){
+		LOGERROR("Cant queue observation for kvalobs." << endl << msg.msg);
+		saveObservation(msg.decoder, msg.msg);
 	}
 }
 
 void
-CollectWmoReports::doNewObs(const std::string &obsFileName, const std::string &obs)
+CollectWmoReports::saveObservation(const std::string &decoder, const std::string &msg)
+{
+	string fname;
+	ostringstream kvOst;
+	string prefix("kvdata_"+decoder+"_");
+
+	kvOst << decoder << endl << msg << endl;
+	fname=writeFile(app.data2kvdir(), prefix, true, kvOst.str());
+
+	if(fname.empty()){
+		LOGERROR("Cant save '" << prefix << "' in directory: " << endl
+				<< app.data2kvdir());
+	}else{
+		LOGINFO("Saved: " << endl << fname << endl);
+	}
+}
+
+/**
+ * Make the messages to send from the reports as WMORaport::split
+ * finds them.
+ */
+class CollectWmoReports::SplitSink : public WMORaportSink
+{
+	CollectWmoReports      &collector;
+	std::vector<KvMessage> &msgs;
+	std::string             decoders[wmoraport::BUFR_SURFACE+1];
+	bool                    lookedUp[wmoraport::BUFR_SURFACE+1];
+
+	/**
+	 * Add a message without the report to msgs.
+	 *
+	 * \return 0 if there is no decoder for \a type.
+	 */
+	KvMessage *newMessage(wmoraport::WmoRaport type, const MsgInfo &info){
+		std::string &theDecoder=decoders[type];
+
+		if(!lookedUp[type]){
+			lookedUp[type]=true;
+			theDecoder=collector.app.getDecoder(type);
+
+			if(theDecoder.empty())
+				LOGERROR("No decoder defined for wmo report <" << type << ">. Cant send data to kvalobs.");
+		}
+
+		if(theDecoder.empty())
+			return 0;
+
+		msgs.emplace_back();
+		KvMessage &kvMsg=msgs.back();
+
+		kvMsg.decoder=theDecoder;
+
+		if(!info.decoderExtra.empty()){
+			kvMsg.decoder+="/";
+			kvMsg.decoder+=info.decoderExtra;
+		}
+
+		kvMsg.priority=info.priority;
+		return &kvMsg;
+	}
+
+	void logMessage(const KvMessage &kvMsg, const wmoraport::ReportFields &fields){
+		const wmoraport::GtsHeader &h=*fields.header;
+
+		LOGDEBUG( "sendWMORaport: decoder: '"<< kvMsg.decoder << "' bulletin: '" << h.ttaaii << " "
+				<< h.cccc << " " << h.yygggg << (h.bbb.empty()?"":" ") << h.bbb << "'"
+				<< (fields.icao.empty()?"":" station: ") << fields.icao
+				<< (fields.time.empty()?"":" time: ") << fields.time
+				<< (fields.cor?" COR":"") << (fields.isAuto?" AUTO":"")
+				<< "\ndata[\n" << kvMsg.msg << "\n]data");
+	}
+
+public:
+	SplitSink(CollectWmoReports &collector_, std::vector<KvMessage> &msgs_)
+		: collector(collector_), msgs(msgs_), lookedUp{}{
+	}
+
+	void report(wmoraport::WmoRaport type, const MsgInfo &info,
+			const wmoraport::ReportFields &fields, std::string_view report) override{
+		KvMessage *kvMsg=newMessage(type, info);
+
+		if(!kvMsg)
+			return;
+
+		if(info.addWhatInFront){
+			kvMsg->msg=info.what;
+			kvMsg->msg+=" \n";
+		}
+
+		kvMsg->msg.append(report);
+		logMessage(*kvMsg, fields);
+	}
+
+	//The encoded BUFR messages is moved to the message as they is.
+	void report(wmoraport::WmoRaport type, const MsgInfo &info,
+			const wmoraport::ReportFields &fields, std::string &&report) override{
+		if(info.addWhatInFront){
+			this->report(type, info, fields, std::string_view(report));
+			return;
+		}
+
+		KvMessage *kvMsg=newMessage(type, info);
+
+		if(!kvMsg)
+			return;
+
+		kvMsg->msg=std::move(report);
+		logMessage(*kvMsg, fields);
+	}
+};
+
+void
+CollectWmoReports::splitChunk(const std::string &obsFileName, std::string_view obs,
+		std::vector<KvMessage> &msgs)
 {
 	std::string err;
 	string      filename(obsFileName);
@@ -417,8 +620,17 @@ CollectWmoReports::doNewObs(const std::string &obsFileName, const std::string &o
 	}
 
 	WMORaport wmoRaport;
+	SplitSink sink(*this, msgs);
+	bool      ok;
+
+	//In test mode the splitted raport is saved, otherwise the reports
+	//is queued for the queuer as they are found.
+	if(app.test())
+		ok=wmoRaport.split(obs, app.getRaportsToCollect());
+	else
+		ok=wmoRaport.split(obs, sink, app.getRaportsToCollect());
 
-	if( ! wmoRaport.split(obs, app.getRaportsToCollect() ) ){
+	if( ! ok ){
 		ostringstream ost;
 		std::string fname;
 		fname=writeFile(app.logdir()+"norcom2kv/", "dataerror_"+filename+"_" , true, obs);
@@ -485,74 +697,34 @@ CollectWmoReports::doNewObs(const std::string &obsFileName, const std::string &o
 			LOGINFO("TEST: saved obsfile to: " << endl
 					<< fname);
 		}
-	}else{
-		sendWMORaport(wmoRaport);
 	}
 }
 
 
 void
-CollectWmoReports::sendWMORaport(const WMORaport &wmoRaports)
+CollectWmoReports::queueReport(KvMessage &kvMsg)
 {
-	ostringstream        ost;
-
-	WMORaport::MsgMapsList raports;
-	bool                 kvServerIsUp;
-	bool                 tryToResend;
-	string decoder;
-	string theDecoder;
-	ostringstream ostDecoder;
-	raports=wmoRaports.getRaports( app.getRaportsToCollect() );
-
-	BOOST_FOREACH(WMORaport::MsgMapsList::value_type raport, raports ) {
-		theDecoder = app.getDecoder( raport.first );
-
-		if( theDecoder.empty() ) {
-			LOGERROR("No decoder defined for wmo report <" << raport.first << ">. Cant send data to kvalobs.");
-			continue;
+	bool queued;
+
+	//Blocks while the queuer is behind.
+	if(kvMsg.priority){
+		queued=prioritySendQueue.push(kvMsg);
+
+		//Wake up the queuer if it waits for sendQueue. When
+		//sendQueue is full the queuer is busy, and it looks in
+		//prioritySendQueue before it queues the next report.
+		if(queued){
+			KvMessage wakeUp;
+			sendQueue.tryPush(wakeUp);
 		}
+	}else{
+		queued=sendQueue.push(kvMsg);
+	}
 
-		BOOST_FOREACH( WMORaport::MsgMap::value_type msgValList, *raport.second ) {
-			ostDecoder.str("");
-			ostDecoder << theDecoder;
-			if( ! msgValList.first.decoderExtra.empty() )
-				ostDecoder << "/"<<msgValList.first.decoderExtra;
-
-			decoder = ostDecoder.str();
-
-			BOOST_FOREACH( WMORaport::MsgList::value_type msg, msgValList.second ){
-				ost.str("");
-
-				if( msgValList.first.addWhatInFront )
-					ost << msgValList.first.what << " " << endl << msg;
-				else
-					ost << msg;
-				LOGDEBUG( "sendWMORaport: decoder: '"<< decoder << "'\ndata[\n"<<ost.str() << "\n]data");
-				if(!sendMessageToKvalobs(ost.str(), decoder, kvServerIsUp,tryToResend)){
-					string fname;
-					ostringstream kvOst;
-
-					LOGERROR("Cant send observation to kvalobs." << endl  <<
-							ost.str());
-					kvOst << decoder << endl << ost.str() << endl;
-
-					if(tryToResend){
-						string prefix("kvdata_"+decoder+"_");
-						fname=writeFile(app.data2kvdir(), prefix, true, kvOst.str());
-
-						if(fname.empty()){
-							LOGERROR("Cant save '" << prefix << "' in directory: " << endl
-									<< app.data2kvdir());
-						}else{
-							LOGINFO("Saved: " << endl << fname << endl);
-						}
-					}
-				}else{
-					LOGINFO("Sendt observation to kvalobs!" << endl <<
-							ost.str());
-				}
-			}
-		}
+	if(!queued && !kvMsg.decoder.empty()){
+		LOGERROR("The pipeline is closed, cant send observation to kvalobs." << endl <<
+				kvMsg.msg);
+		saveObservation(kvMsg.decoder, kvMsg.msg);
 	}
 }
 
@@ -560,7 +732,7 @@ std::string
 CollectWmoReports::writeFile(const std::string &dir, 
 		const std::string &fname,
 		bool  fnameIsTemplate,
-		const std::string &content)
+		std::string_view content)
 {
 	const int MAX_COUNT=10000;
 	ostringstream ost;
@@ -588,16 +760,19 @@ CollectWmoReports::writeFile(const std::string &dir,
 				ost << "_" << i;
 
 			file=ost.str();
-			fd=fopen(file.c_str(), "r");
 
-			if(!fd){
-				fd=fopen(file.c_str(), "w");
+			//O_EXCL, so two threads cant get the same name.
+			int fdes=open(file.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+
+			if(fdes>=0){
+				fd=fdopen(fdes, "w");
+
+				if(!fd)
+					close(fdes);
 
-				if(fd)
-					break; //Break out of the while loop
-			}else {
-				fclose(fd);
-				fd = 0;
+				break; //Break out of the while loop
+			}else if(errno!=EEXIST){
+				return string();
 			}
 
 			i++;
@@ -618,7 +793,7 @@ CollectWmoReports::writeFile(const std::string &dir,
 	if( ! fd )
 		return "";
 
-	fwRet=fwrite(content.c_str(), content.length(), 1, fd);
+	fwRet=fwrite(content.data(), content.length(), 1, fd);
 	fclose(fd);
 
 	if(fwRet!=1){
@@ -629,183 +804,3 @@ CollectWmoReports::writeFile(const std::string &dir,
 	return file;
 }
 
-std::string
-CollectWmoReports::getNewObsPart(const std::string &obs, IFInfoList &it)
-{
-	std::string  sub;
-	std::string  newObs;
-	unsigned int crc;
-
-	if(it->second.offset()>0){
-		if(it->second.offset()<=obs.length()){
-			sub=obs.substr(0, it->second.offset());
-			crc=crc_ccitt(sub);
-
-			if(crc==it->second.crc()){
-				newObs=obs.substr(it->second.offset());
-
-				if(newObs.empty()){
-					LOGDEBUG("New observation: No new data. " <<
-							"The file has only been touched.\n");
-				}else{
-					LOGDEBUG("New observations: appended to file!\n");
-				}
-			}else{
-				LOGDEBUG("New Observations: overwritten file!");
-				newObs=obs;
-			}
-		}else{
-			//The file is truncated.
-			LOGDEBUG("The file is truncated! (overwritten file)");
-			newObs=obs;
-		}
-	}else{
-		LOGDEBUG("New observations: New file!");
-		newObs=obs;
-	}
-
-	it->second.offset(obs.length());
-	it->second.crc(crc_ccitt(obs));
-
-	return newObs;
-}
-
-
-bool
-CollectWmoReports::checkForNewObservations()
-{
-	string    message;
-	string    obsType;
-	FileList  fileList;
-	IFileList it;
-	IFInfoList fiIt;
-	IFInfoList tmpFiIt;
-	bool       hasNewFilesToCollect=false;
-
-	if(!getFileList(fileList, app.synopdir())){
-		LOGINFO("No new observations!");
-		return false;
-	}
-
-	//We deletes all entries (files) in fileInfoList
-	//that no longer is in the directory. ie. all files
-	//that is in fileInfoList and not in fileList.
-
-	fiIt=fileInfoList.begin();
-
-	while(fiIt!=fileInfoList.end()){
-		for(it=fileList.begin(); it!=fileList.end(); it++){
-			if(it->name()==fiIt->first)
-				break;
-		}
-
-		if(it==fileList.end()){
-			LOGDEBUG("Erase <" << fiIt->first << "> from fileInfoList\n");
-			tmpFiIt=fiIt;
-			fiIt++;
-			fileInfoList.erase(tmpFiIt);
-		}else{
-			fiIt++;
-		}
-	}
-
-	//Checks if there is new files in the dierctory. Add
-	//them to the fileInfoList.
-
-	for(it=fileList.begin();
-			it!=fileList.end();
-			it++){
-
-		fiIt=fileInfoList.find(it->name());
-
-		if(fiIt==fileInfoList.end()){
-			LOGDEBUG("New entrie: <" << it->name()
-					<< "> in fileInfoList\n");
-			fileInfoList[it->name()]=FInfo(*it);
-		}else{
-			if(fiIt->second.mtime() != it->mtime()){
-				LOGDEBUG("New mtime: <" << it->name() << ">");
-
-				try{
-					fiIt->second.mtimeNow();
-					fiIt->second.seen(false);
-					fiIt->second.collected(false);
-				}catch(FInfo::StatException &ex){
-					LOGINFO("The file has gone: " << it->name());
-					fileInfoList.erase(fiIt);
-					fiIt=fileInfoList.end();
-				}
-
-			}else if(fiIt->second.seen()){  //fiIt->second.mtime() == it->mtime()
-				if(!fiIt->second.collected()){
-					LOGDEBUG("mtime seen a second time: <" << it->name() << ">\n");
-					fiIt=copyFile(fileInfoList, fiIt);
-				}
-			}else{
-				fiIt->second.seen(true);
-			}
-		}
-
-		if(fiIt!=fileInfoList.end()){
-			if(fiIt->second.toBeCollected()){
-				LOGINFO("New observation in file: " << fiIt->second.name()
-						<< endl << "A copy of the file is: " <<
-						fiIt->second.copy());
-				hasNewFilesToCollect=true;
-			}
-		}
-	}
-
-	return hasNewFilesToCollect;
-}
-
-
-IFInfoList 
-CollectWmoReports::
-copyFile(FInfoList &infoList, IFInfoList it)
-{
-	time_t oldtime=it->second.mtime();
-	miTime now(miTime::nowTime());
-	char buf[32];
-
-	sprintf(buf, "_%04d%02d%02dT%02d%02d%02d",
-			now.year(), now.month(), now.day(),
-			now.hour(), now.min(), now.sec());
-
-	string tofile=app.tmpdir()+it->second.namepart()+buf;
-
-	LOGDEBUG("Copysynopfile: " << it->second.name() << endl <<
-			"-----------to: " << tofile);
-
-	if(!miutil::file::copyfile(it->second.name(), tofile)){
-		LOGWARN("Cant copy synopfile: " << it->second.name() << endl <<
-				"---------------- to: " << tofile <<
-				"Removing <"<< it->second.name() <<"> from InfoList!");
-		infoList.erase(it);
-		return infoList.end();
-	}
-
-	try{
-		it->second.mtimeNow();
-	}
-	catch(FInfo::StatException &ex){
-		LOGINFO("The synop file has gone: " << it->second.name());
-		infoList.erase(it);
-		return infoList.end();
-	}
-
-	if(it->second.mtime()!=oldtime){
-		LOGDEBUG("Synopfile: <" << it->second.name() <<
-				"> has changed after copy!" << endl <<
-				"Removing copy: " << tofile);
-		unlink(tofile.c_str());
-		it->second.seen(false);
-		it->second.collected(false);
-	}else{
-		it->second.removecopy(!app.debug());
-
-		it->second.copy(tofile);
-	}
-
-	return it;
-}
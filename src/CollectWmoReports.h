@@ -33,20 +33,24 @@
 
 
 #include <string>
+#include <string_view>
 #include <map>
 #include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include "App.h"
 #include "FInfo.h"
 #include "File.h"
 #include "WMORaport.h"
+#include "DirScanner.h"
+#include "DirCollector.h"
+#include "WorkerPool.h"
+#include "BoundedQueue.h"
 
 
-
-typedef std::list<File>                   FileList;
-typedef std::list<File>::iterator        IFileList;
-typedef std::list<File>::const_iterator CIFileList;
-
 class CollectWmoReports
 {
     CollectWmoReports(CollectWmoReports&);
@@ -54,19 +58,132 @@ class CollectWmoReports
     CollectWmoReports();
     
     App                             &app;
-    FInfoList                       fileInfoList;
+    DirScanner                      scanner;
     boost::posix_time::ptime ignoreFilesBefore;
-    
-    bool checkForNewObservations();
-    void collectObservations();
-    std::string getNewObsPart(const std::string &obs, 
-			      IFInfoList &it);
+    std::unique_ptr<WorkerPool>     pool;
+    std::list<std::unique_ptr<DirCollector>> collectors;
 
-    void doNewObs(const std::string &obsFileName,
-		  const std::string &newObs);
+    /**
+     * The state of the files in a directory. It goes through the
+     * pipeline after the new observations from the files, and is saved
+     * when the reports from them is in the delivery queue.
+     */
+    struct DirState {
+        std::string dir;
+        FInfoList   infoList;
+    };
+
+    /**
+     * The new observations from a file, or a chunk of whole bulletins
+     * from it. The framer numbers the chunks in the order they is cut.
+     * A chunk with a state has no observations.
+     */
+    struct ObsChunk {
+        std::string        file;
+        std::string        obs;
+        unsigned long long seq;
+        std::shared_ptr<DirState> state;
+    };
+
+    /**
+     * A report that is ready to be sent to kvalobs. A message with an
+     * empty decoder is a state to save or it only wakes up the queuer,
+     * see queueReport.
+     */
+    struct KvMessage {
+        std::string decoder;
+        std::string msg;
+        bool        priority;
+        std::shared_ptr<DirState> state;
+
+        KvMessage(): priority(false){}
+    };
+
+    //The stages of the pipeline:
+    //  DirCollectors -> framingQueue -> framer -> splitQueue -> splitters
+    //  -> merge -> sendQueue -> queuer -> delivery queue.
+    //A full queue blocks the stage that pushes to it, so a slow
+    //disk slows down the collecting of files. The splitters split
+    //the chunks in parallel, also the chunks from the same file. The
+    //merge queues the reports from the chunks in the order the chunks
+    //was cut, so the reports is sent in the same order as when the
+    //chunks is split one by one. The priority reports, ie. SPECI, goes
+    //through prioritySendQueue and is queued before the reports in
+    //sendQueue. The kvservers is delivered to from the delivery queue,
+    //see KvDelivery.
+    BoundedQueue<ObsChunk>          framingQueue;
+    BoundedQueue<ObsChunk>          splitQueue;
+    BoundedQueue<KvMessage>         sendQueue;
+    BoundedQueue<KvMessage>         prioritySendQueue;
+    std::thread                     framer;
+    std::list<std::thread>          splitters;
+    std::thread                     queuer;
+
+    //The reports from the chunks that is split before a chunk in
+    //front of them, they wait for it in mergeChunks.
+    std::mutex                      mergeMutex;
+    unsigned long long              nextChunk;
+    std::map<unsigned long long, std::vector<KvMessage>> mergeChunks;
+
+    //The state of all the directories is saved in one state file.
+    std::mutex                      stateMutex;
+    std::string                     stateFile;
+    std::map<std::string, FInfoList> stateShards;
+
+    /**
+     * Cut the new observations in chunks of whole bulletins.
+     */
+    void frameObservations();
 
-    void sendWMORaport(const WMORaport &raport);
-    void tryToSendSavedObservations();
+    /**
+     * Split the chunks in splitQueue in reports.
+     */
+    void splitObservations();
+
+    /**
+     * Queue the reports \a msgs from chunk \a seq for the sender,
+     * after the reports from the chunks before it.
+     */
+    void mergeChunk(unsigned long long seq, std::vector<KvMessage> &msgs);
+
+    /**
+     * Add the reports to the delivery queue, and save the states when
+     * the reports before them is durable.
+     */
+    void queueObservations();
+
+    /**
+     * Add \a msg to the delivery queue, it is saved to data2kvdir if
+     * it cant be added.
+     */
+    void queueObservation(const KvMessage &msg);
+
+    /**
+     * Save \a state to the state file. The state file contains the
+     * last saved state of every directory.
+     */
+    void saveState(const DirState &state);
+
+    /**
+     * Split \a obs, the reports to send is added to \a msgs.
+     */
+    void splitChunk(const std::string &obsFileName, std::string_view obs,
+                    std::vector<KvMessage> &msgs);
+
+    class SplitSink;
+
+    /**
+     * Queue \a msg for the queuer. The priority reports is queued
+     * before the others. \a msg is moved from.
+     */
+    void queueReport(KvMessage &msg);
+
+    /**
+     * Save an observation we cant queue now to data2kvdir, it is
+     * queued by queueSavedObservations.
+     */
+    void saveObservation(const std::string &decoder, const std::string &msg);
+    void queueSavedObservations();
 
 
 
@@ -74,11 +191,6 @@ class CollectWmoReports
 		     const std::string &path,
 		     const std::string &pattern="");
 
-    bool sendMessageToKvalobs(const std::string &msg, 
-			      const std::string &obsType,
-			      bool &kvServerIsUp,
-			      bool &tryToResend)const;
- 
     /**
      * 
      * \return the file name on success and an empty string otherwise.
@@ -86,30 +198,33 @@ class CollectWmoReports
     std::string writeFile(const std::string &dir, 
 			  const std::string &fname,
 			  bool  fnameIsTemplate,
-			  const std::string &content);
+			  std::string_view content);
       
     bool readFile(const std::string &file, std::string &content)const;
 
-
-    /**
-     * copy a synopfile to the tmpdir. Check if the source file
-     * has changed after the copy, if it has changed remove the
-     * copy and set the collected flag to false and the seen count to 0.
-     *
-     * If we cant copy the file, remove the file from the InfoList. We
-     * assume the file has been deleted.
-     *
-     * \param infoList A referance to the infolist.
-     * \param it an iterator to an element in infoList.
-     * \return An iteretor to infoList.end() if the file referenced by 
-     *         it is deleted and the iterator it otherwise.
-     */
-    IFInfoList copyFile(FInfoList &infoList, IFInfoList it); 
-    
 public:
     CollectWmoReports(App &app); 
     ~CollectWmoReports();
     
+    /**
+     * Queue the new observations in \a newObs, from the file
+     * \a obsFileName, to be split and sent to kvalobs. It is called
+     * from the DirCollector and WorkerPool threads, and blocks while
+     * the pipeline is full.
+     */
+    void doNewObs(const std::string &obsFileName,
+		  std::string_view newObs);
+    void doNewObs(const std::string &obsFileName,
+		  std::string &&newObs);
+
+    /**
+     * Save the state of the files in the directory \a dir to the state
+     * file, when the reports from the observations queued before it is
+     * durable in the delivery queue. A state is never saved for a
+     * report that may be lost.
+     */
+    void saveFInfoList(const std::string &dir, const FInfoList &fileInfoList);
+
     int run();
 };
 
@@ -0,0 +1,612 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <milog/milog.h>
+#include "crc_ccitt.h"
+#include "DirScanner.h"
+#include "DeliveryQueue.h"
+
+using namespace std;
+
+namespace {
+//A new segment is started when the last segment is this big.
+const off_t SEGMENT_SIZE=16*1024*1024;
+
+//The cursors is saved this long after a cursor is moved.
+const std::chrono::milliseconds CURSOR_SAVE_INTERVAL(1000);
+
+//A record is a header followed by the decoder and the message. The
+//header is the magic, the crc of the lengths, the decoder and the
+//message, the length of the decoder and the length of the message.
+//The top bit of the length of the decoder is set for a priority
+//message, it is covered by the crc.
+const unsigned short MAGIC=0x4b56;
+const size_t HEADER_SIZE=12;
+const unsigned int PRIORITY_FLAG=0x80000000;
+
+struct Header {
+	unsigned short magic;
+	unsigned short crc;
+	unsigned int   decoderLen;
+	unsigned int   msgLen;
+	bool           priority;
+};
+
+void
+getHeader(const char *buf, Header &h)
+{
+	memcpy(&h.magic, buf, 2);
+	memcpy(&h.crc, buf+2, 2);
+	memcpy(&h.decoderLen, buf+4, 4);
+	memcpy(&h.msgLen, buf+8, 4);
+	h.priority=(h.decoderLen & PRIORITY_FLAG)!=0;
+	h.decoderLen&=~PRIORITY_FLAG;
+}
+
+unsigned short
+recordCrc(const char *lengths, const char *decoder, size_t decoderLen,
+		const char *msg, size_t msgLen)
+{
+	unsigned int crc=crc_ccitt(lengths, 8);
+	crc=crc_ccitt(decoder, decoderLen, crc);
+	return crc_ccitt(msg, msgLen, crc);
+}
+
+bool
+writeAll(int fd, const char *buf, size_t n)
+{
+	while(n>0){
+		ssize_t r=write(fd, buf, n);
+
+		if(r<0){
+			if(errno==EINTR)
+				continue;
+
+			return false;
+		}
+
+		buf+=r;
+		n-=r;
+	}
+
+	return true;
+}
+
+bool
+readAll(int fd, char *buf, size_t n, off_t offset)
+{
+	while(n>0){
+		ssize_t r=pread(fd, buf, n, offset);
+
+		if(r<0){
+			if(errno==EINTR)
+				continue;
+
+			return false;
+		}
+
+		if(r==0)
+			return false;
+
+		buf+=r;
+		n-=r;
+		offset+=r;
+	}
+
+	return true;
+}
+
+/**
+ * Make the new and removed files in \a dir durable.
+ */
+void
+syncDir(const std::string &dir)
+{
+	int fd=::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+
+	if(fd<0)
+		return;
+
+	fsync(fd);
+	::close(fd);
+}
+}
+
+DeliveryQueue::DeliveryQueue(const std::string &dir_, const TKvDataSrcList &kvservers)
+	:dir(dir_), servers(kvservers.begin(), kvservers.end()),
+	 savedCursors(servers.size(), 0), end_(0), synced(true),
+	 cursors(servers.size(), 0)
+{
+}
+
+DeliveryQueue::~DeliveryQueue()
+{
+	for(Segment &segment : segments){
+		if(segment.fd>=0)
+			::close(segment.fd);
+	}
+}
+
+std::string
+DeliveryQueue::cursorFile(size_t server)const
+{
+	string name(servers[server]);
+
+	for(char &c : name){
+		if(!isalnum(static_cast<unsigned char>(c)) && c!='.' && c!='-')
+			c='_';
+	}
+
+	return dir+"cursor_"+name;
+}
+
+bool
+DeliveryQueue::recover(Segment &segment)
+{
+	string buf;
+	off_t  offset=0;
+
+	buf.resize(segment.size);
+
+	if(segment.size>0 && !readAll(segment.fd, &buf[0], segment.size, 0)){
+		LOGERROR("DeliveryQueue: Cant read <" << segment.file << ">: " << strerror(errno));
+		return false;
+	}
+
+	while(offset+static_cast<off_t>(HEADER_SIZE)<=segment.size){
+		Header h;
+		const char *p=buf.data()+offset;
+
+		getHeader(p, h);
+
+		if(h.magic!=MAGIC || h.decoderLen==0 ||
+				static_cast<off_t>(h.decoderLen)+h.msgLen>segment.size-offset-static_cast<off_t>(HEADER_SIZE) ||
+				h.crc!=recordCrc(p+4, p+HEADER_SIZE, h.decoderLen,
+						p+HEADER_SIZE+h.decoderLen, h.msgLen))
+			break;
+
+		if(h.priority)
+			priorities.push_back(segment.first+segment.offsets.size());
+
+		segment.offsets.push_back(offset);
+		offset+=HEADER_SIZE+h.decoderLen+h.msgLen;
+	}
+
+	if(offset<segment.size){
+		LOGWARN("DeliveryQueue: The last " << segment.size-offset << " bytes of <" << segment.file
+				<< "> is not a whole message, it is cut off.");
+
+		if(ftruncate(segment.fd, offset)<0){
+			LOGERROR("DeliveryQueue: Cant truncate <" << segment.file << ">: " << strerror(errno));
+			return false;
+		}
+
+		segment.size=offset;
+	}
+
+	return true;
+}
+
+bool
+DeliveryQueue::open()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	DirScanner scanner;
+	FileList   files;
+	unsigned long long logEnd=0;
+
+	if(!scanner.scan(dir, "*.log", files)){
+		LOGERROR("DeliveryQueue: Cant read <" << dir << ">: " << scanner.error());
+		return false;
+	}
+
+	//The segments is named by the sequence number of the first
+	//record in it, zero padded, so they sort by the name.
+	std::sort(files.begin(), files.end(),
+			[](const File &a, const File &b){ return a.name()<b.name(); });
+
+	for(const File &f : files){
+		Segment segment;
+		char   *end;
+
+		segment.file=f.name();
+		segment.first=strtoull(f.namepart().c_str(), &end, 10);
+
+		if(*end!='.'){
+			LOGWARN("DeliveryQueue: <" << segment.file << "> is not a segment, it is ignored.");
+			continue;
+		}
+
+		segment.fd=::open(segment.file.c_str(), O_RDWR | O_APPEND);
+
+		if(segment.fd<0){
+			LOGERROR("DeliveryQueue: Cant open <" << segment.file << ">: " << strerror(errno));
+			return false;
+		}
+
+		segment.size=lseek(segment.fd, 0, SEEK_END);
+		segments.push_back(segment);
+
+		if(!recover(segments.back()))
+			return false;
+
+		if(segments.back().first<logEnd)
+			LOGWARN("DeliveryQueue: <" << segment.file << "> overlaps the segment before it.");
+		else if(segments.size()>1 && segments.back().first>logEnd)
+			LOGERROR("DeliveryQueue: The messages " << logEnd << " to " << segments.back().first-1
+					<< " is lost from the log, they is not delivered.");
+
+		logEnd=segments.back().first+segments.back().offsets.size();
+	}
+
+	end_=logEnd;
+
+	for(size_t i=0; i<servers.size(); i++){
+		ifstream fs(cursorFile(i).c_str());
+		unsigned long long cursor;
+
+		if(!fs){
+			//A new kvserver gets the messages from now on.
+			cursors[i]=~0ULL;
+			continue;
+		}
+
+		if(!(fs >> cursor)){
+			//The cursor file was not completely written, the messages
+			//in the log is delivered again.
+			LOGWARN("DeliveryQueue: Cant read <" << cursorFile(i) << ">, sending all messages in the log to "
+					<< servers[i] << ".");
+			cursor=0;
+		}
+
+		cursors[i]=cursor;
+
+		if(cursor>end_)
+			end_=cursor;
+	}
+
+	bool newCursors=false;
+
+	for(size_t i=0; i<servers.size(); i++){
+		//The cursor of a new kvserver is saved now, the messages from
+		//now on must be delivered to it even if we go down soon.
+		if(cursors[i]==~0ULL){
+			cursors[i]=end_;
+			savedCursors[i]=end_;
+
+			if(!saveCursor(i, end_))
+				return false;
+
+			newCursors=true;
+			continue;
+		}
+
+		if(!segments.empty() && cursors[i]<segments.front().first)
+			cursors[i]=segments.front().first;
+
+		savedCursors[i]=cursors[i];
+		LOGINFO("DeliveryQueue: " << end_-cursors[i] << " messages is waiting for " << servers[i] << ".");
+	}
+
+	if(newCursors)
+		syncDir(dir);
+
+	cursorsSavedAt=std::chrono::steady_clock::now();
+	return true;
+}
+
+bool
+DeliveryQueue::newSegment()
+{
+	char   name[32];
+	Segment segment;
+
+	//The segment before it is not synced by sync.
+	if(!segments.empty() && !synced && !syncSegment(segments.back()))
+		return false;
+
+	snprintf(name, sizeof(name), "%020llu.log", end_);
+	segment.file=dir+name;
+	segment.first=end_;
+	segment.fd=::open(segment.file.c_str(), O_RDWR | O_APPEND | O_CREAT | O_TRUNC, 0644);
+
+	if(segment.fd<0){
+		LOGERROR("DeliveryQueue: Cant create <" << segment.file << ">: " << strerror(errno));
+		return false;
+	}
+
+	syncDir(dir);
+	segments.push_back(segment);
+	return true;
+}
+
+bool
+DeliveryQueue::syncSegment(Segment &segment)
+{
+	if(fdatasync(segment.fd)<0){
+		LOGERROR("DeliveryQueue: Cant sync <" << segment.file << ">: " << strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+bool
+DeliveryQueue::append(const std::string &decoder, const std::string &msg, bool priority)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	char header[HEADER_SIZE];
+	unsigned short magic=MAGIC;
+	unsigned short crc;
+	unsigned int   decoderLen=decoder.size();
+	unsigned int   msgLen=msg.size();
+	unsigned int   flags=priority?PRIORITY_FLAG:0;
+
+	if(decoderLen==0 || (decoderLen & PRIORITY_FLAG) || (msgLen & PRIORITY_FLAG)){
+		LOGERROR("DeliveryQueue: Cant append a message of " << msgLen << " bytes to the decoder <"
+				<< decoder << ">.");
+		return false;
+	}
+
+	if(segments.empty() || segments.back().size>=SEGMENT_SIZE ||
+			segments.back().first+segments.back().offsets.size()!=end_){
+		if(!newSegment())
+			return false;
+	}
+
+	Segment &segment=segments.back();
+
+	flags|=decoderLen;
+	memcpy(header, &magic, 2);
+	memcpy(header+4, &flags, 4);
+	memcpy(header+8, &msgLen, 4);
+	crc=recordCrc(header+4, decoder.data(), decoderLen, msg.data(), msgLen);
+	memcpy(header+2, &crc, 2);
+
+	if(!writeAll(segment.fd, header, HEADER_SIZE) ||
+			!writeAll(segment.fd, decoder.data(), decoderLen) ||
+			!writeAll(segment.fd, msg.data(), msgLen)){
+		LOGERROR("DeliveryQueue: Cant write to <" << segment.file << ">: " << strerror(errno));
+
+		//Dont leave a part of the record in front of the next.
+		if(ftruncate(segment.fd, segment.size)<0)
+			LOGERROR("DeliveryQueue: Cant truncate <" << segment.file << ">: " << strerror(errno));
+
+		return false;
+	}
+
+	if(priority)
+		priorities.push_back(end_);
+
+	segment.offsets.push_back(segment.size);
+	segment.size+=HEADER_SIZE+decoderLen+msgLen;
+	end_++;
+	synced=false;
+	return true;
+}
+
+bool
+DeliveryQueue::sync()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(synced || segments.empty())
+		return true;
+
+	if(!syncSegment(segments.back()))
+		return false;
+
+	synced=true;
+	return true;
+}
+
+DeliveryQueue::ReadResult
+DeliveryQueue::read(unsigned long long seq, Record &record)const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::deque<Segment>::const_iterator it=std::upper_bound(segments.begin(), segments.end(), seq,
+			[](unsigned long long s, const Segment &segment){ return s<segment.first; });
+
+	if(it==segments.begin())
+		return READ_MISSING;
+
+	const Segment &segment=*--it;
+
+	if(seq-segment.first>=segment.offsets.size())
+		return READ_MISSING;
+
+	size_t i=seq-segment.first;
+	off_t  offset=segment.offsets[i];
+	off_t  next=i+1<segment.offsets.size()?segment.offsets[i+1]:segment.size;
+	string buf;
+	Header h;
+
+	buf.resize(next-offset);
+
+	if(!readAll(segment.fd, &buf[0], buf.size(), offset)){
+		LOGERROR("DeliveryQueue: Cant read message " << seq << " from <" << segment.file << ">: "
+				<< strerror(errno));
+		return READ_ERROR;
+	}
+
+	getHeader(buf.data(), h);
+
+	if(h.magic!=MAGIC || HEADER_SIZE+h.decoderLen+h.msgLen!=buf.size() ||
+			h.crc!=recordCrc(buf.data()+4, buf.data()+HEADER_SIZE, h.decoderLen,
+					buf.data()+HEADER_SIZE+h.decoderLen, h.msgLen)){
+		LOGERROR("DeliveryQueue: Message " << seq << " in <" << segment.file << "> is corrupt.");
+		return READ_ERROR;
+	}
+
+	record.seq=seq;
+	record.priority=h.priority;
+	record.decoder.assign(buf, HEADER_SIZE, h.decoderLen);
+	record.msg.assign(buf, HEADER_SIZE+h.decoderLen, h.msgLen);
+	return READ_OK;
+}
+
+bool
+DeliveryQueue::nextPriority(unsigned long long &seq)const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::deque<unsigned long long>::const_iterator it=
+			std::lower_bound(priorities.begin(), priorities.end(), seq);
+
+	if(it==priorities.end())
+		return false;
+
+	seq=*it;
+	return true;
+}
+
+unsigned long long
+DeliveryQueue::end()const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return end_;
+}
+
+unsigned long long
+DeliveryQueue::cursor(size_t server)const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return cursors[server];
+}
+
+std::chrono::steady_clock::time_point
+DeliveryQueue::setCursor(size_t server, unsigned long long seq)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(seq<=cursors[server])
+		return std::chrono::steady_clock::time_point::max();
+
+	cursors[server]=seq;
+	return cursorsSavedAt+CURSOR_SAVE_INTERVAL;
+}
+
+bool
+DeliveryQueue::saveCursor(size_t server, unsigned long long cursor)
+{
+	string file(cursorFile(server));
+	string tmp(file+".tmp");
+	char   buf[32];
+	int    n=snprintf(buf, sizeof(buf), "%llu\n", cursor);
+	int    fd=::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if(fd<0){
+		LOGERROR("DeliveryQueue: Cant create <" << tmp << ">: " << strerror(errno));
+		return false;
+	}
+
+	//The cursor must be on disk before the rename, or the cursor file
+	//may be empty after a crash.
+	if(!writeAll(fd, buf, n) || fsync(fd)<0){
+		LOGERROR("DeliveryQueue: Cant write <" << tmp << ">: " << strerror(errno));
+		::close(fd);
+		return false;
+	}
+
+	::close(fd);
+
+	if(rename(tmp.c_str(), file.c_str())<0){
+		LOGERROR("DeliveryQueue: Cant rename <" << tmp << "> to <" << file << ">: " << strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+void
+DeliveryQueue::saveCursors()
+{
+	//The files is written without the lock, so the appends and the
+	//reads is not held back. saveMutex lets one thread save at a time.
+	std::lock_guard<std::mutex> saveLock(saveMutex);
+	std::vector<unsigned long long> current;
+	std::vector<size_t> saved;
+	std::deque<Segment> removed;
+	unsigned long long delivered=~0ULL;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		current=cursors;
+		cursorsSavedAt=std::chrono::steady_clock::now();
+	}
+
+	for(size_t i=0; i<servers.size(); i++){
+		if(current[i]!=savedCursors[i] && saveCursor(i, current[i]))
+			saved.push_back(i);
+	}
+
+	if(saved.empty())
+		return;
+
+	//The renames must be durable before the segments the new cursors
+	//is past is removed.
+	syncDir(dir);
+
+	for(size_t i : saved)
+		savedCursors[i]=current[i];
+
+	for(unsigned long long cursor : savedCursors)
+		delivered=std::min(delivered, cursor);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		//The last segment is kept, it is the one that is appended to.
+		while(segments.size()>1 && segments[1].first<=delivered){
+			removed.push_back(segments.front());
+			segments.pop_front();
+		}
+
+		while(!priorities.empty() && priorities.front()<segments.front().first)
+			priorities.pop_front();
+	}
+
+	if(removed.empty())
+		return;
+
+	for(Segment &segment : removed){
+		::close(segment.fd);
+
+		if(unlink(segment.file.c_str())<0)
+			LOGERROR("DeliveryQueue: Cant remove <" << segment.file << ">: " << strerror(errno));
+	}
+
+	syncDir(dir);
+}
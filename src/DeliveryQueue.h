@@ -0,0 +1,183 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __DeliveryQueue_h__
+#define __DeliveryQueue_h__
+
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include "kvDataSrcList.h"
+
+/**
+ * A durable queue of the messages to send to the kvservers, shared by
+ * all the kvservers.
+ *
+ * The messages is appended to a log of segment files in a directory,
+ * and each message gets the next sequence number. Each kvserver has a
+ * cursor in the log, the sequence number of the first message that is
+ * not delivered to it. The cursors is saved in a file for each
+ * kvserver, and a segment is removed when all the kvservers is past
+ * it. A kvserver that is behind only keeps the segments, it does not
+ * hold back the other kvservers.
+ *
+ * A message is durable when sync has returned. When the log is opened
+ * a message that was not completely written, ie. the program or the
+ * machine went down while it was written, is cut off the log.
+ */
+class DeliveryQueue
+{
+	DeliveryQueue(const DeliveryQueue&);
+	DeliveryQueue& operator=(const DeliveryQueue&);
+
+public:
+	struct Record {
+		unsigned long long seq;
+		bool               priority;
+		std::string        decoder;
+		std::string        msg;
+
+		Record(): seq(0), priority(false){}
+	};
+
+	typedef enum { READ_OK,      //The message is read.
+	               READ_MISSING, //There is no message with the sequence number.
+	               READ_ERROR    //The message is in the log, but it cant be read now.
+	} ReadResult;
+
+private:
+	struct Segment {
+		unsigned long long  first;
+		std::string         file;
+		int                 fd;
+		off_t               size;
+		std::vector<off_t>  offsets; //The offset of each record.
+
+		Segment(): first(0), fd(-1), size(0){}
+	};
+
+	std::string dir;
+	std::vector<std::string> servers;
+
+	//Protects savedCursors, the cursors on disk. A segment is removed
+	//only when all the saved cursors is past it.
+	std::mutex saveMutex;
+	std::vector<unsigned long long> savedCursors;
+
+	//Protects all below.
+	mutable std::mutex mutex;
+	std::deque<Segment> segments;
+	unsigned long long  end_;
+	bool                synced;
+	std::vector<unsigned long long> cursors;
+	std::chrono::steady_clock::time_point cursorsSavedAt;
+	std::deque<unsigned long long> priorities; //The priority messages in the log.
+
+	std::string cursorFile(size_t server)const;
+	bool recover(Segment &segment);
+	bool newSegment();
+	bool syncSegment(Segment &segment);
+	bool saveCursor(size_t server, unsigned long long cursor);
+
+public:
+	/**
+	 * \param dir The directory of the log, it must exist.
+	 * \param kvservers The kvservers to deliver to, the cursor for a
+	 *        kvserver is found by the name.
+	 */
+	DeliveryQueue(const std::string &dir, const TKvDataSrcList &kvservers);
+	~DeliveryQueue();
+
+	/**
+	 * Read the log and the cursors. A kvserver without a cursor, ie.
+	 * a new kvserver, starts at the end of the log.
+	 *
+	 * \return false if the log cant be read.
+	 */
+	bool open();
+
+	/**
+	 * Append \a msg to \a decoder to the log. It is not durable before
+	 * sync is called. A \a priority message, ie. a SPECI, is found by
+	 * nextPriority so it can be sent ahead of the messages before it.
+	 *
+	 * \return false if it cant be written.
+	 */
+	bool append(const std::string &decoder, const std::string &msg, bool priority=false);
+
+	/**
+	 * Make the messages appended so far durable.
+	 */
+	bool sync();
+
+	/**
+	 * Read the message \a seq.
+	 *
+	 * \return READ_MISSING if there is no message \a seq. It is either
+	 *         not appended yet, or it was lost from the log when it was
+	 *         opened, that is logged by open. READ_ERROR if the message
+	 *         cant be read or is corrupt, it may be read later.
+	 */
+	ReadResult read(unsigned long long seq, Record &record)const;
+
+	/**
+	 * Find the first priority message from \a seq, it is returned in
+	 * \a seq.
+	 *
+	 * \return false if there is none.
+	 */
+	bool nextPriority(unsigned long long &seq)const;
+
+	/**
+	 * The sequence number the next message gets.
+	 */
+	unsigned long long end()const;
+
+	unsigned long long cursor(size_t server)const;
+
+	/**
+	 * The messages before \a seq is delivered to \a server. The cursor
+	 * only moves forward. It is only noted, it is saved by saveCursors,
+	 * so it can be called with a lock held.
+	 *
+	 * \return When saveCursors should be called, it is max if the
+	 *         cursor is not moved.
+	 */
+	std::chrono::steady_clock::time_point setCursor(size_t server, unsigned long long seq);
+
+	/**
+	 * Save the cursors that is changed and remove the segments that is
+	 * delivered to all the kvservers.
+	 */
+	void saveCursors();
+};
+
+#endif
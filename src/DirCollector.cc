@@ -0,0 +1,666 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <algorithm>
+#include <boost/foreach.hpp>
+#include <milog/milog.h>
+#include "DirCollector.h"
+#include "CollectWmoReports.h"
+#include "crc_ccitt.h"
+#include "MappedFile.h"
+#include "Snapshot.h"
+#include <puTools/miTime.h>
+
+using namespace std;
+using namespace miutil;
+
+DirCollector::DirCollector(App &app_, CollectWmoReports &pipeline_,
+		WorkerPool *pool_,
+		const std::string &dir, const std::string &tmpPrefix,
+		const FInfoList &fileInfoList_)
+:app(app_), pipeline(pipeline_), pool(pool_), dir_(dir), tmpPrefix_(tmpPrefix),
+ fileInfoList(fileInfoList_), ignoreFilesBefore( app.ignoreFilesBeforeStartup )
+{
+}
+
+DirCollector::~DirCollector()
+{
+	join();
+}
+
+void
+DirCollector::start()
+{
+	thread_=std::thread(&DirCollector::run, this);
+}
+
+void
+DirCollector::join()
+{
+	if(thread_.joinable())
+		thread_.join();
+}
+
+void
+DirCollector::run()
+{
+	const  int DELAY=3;
+	time_t  tNow;
+	time_t  newObsCheckTime=0;
+	time_t  watchCheckTime=0;
+	long long pendingCheckTime=0;
+	bool    pending=false;
+	bool    newObs;
+	int     timeout;
+	DirWatcher watcher;
+	DirEvents  events;
+
+	LOGINFO("DirCollector: collecting from '" << dir_ << "'.");
+
+	if(app.useInotify())
+		watcher.watch(dir_);
+
+	while(!app.inShutdown()){
+		newObs=false;
+		events.clear();
+
+		//While there is files we wait for the writer to finish, we
+		//must check them every quiet period.
+		timeout=1000;
+
+		if(pending && app.quietPeriod()<timeout)
+			timeout=app.quietPeriod()>10?app.quietPeriod():10;
+
+		if(watcher.ok()){
+			//Wait for changes in the directory. The full scan of the
+			//directory is only a safety net for lost events.
+			if(watcher.wait(timeout, events)<0){
+				LOGWARN("inotify: failed, falling back to scanning the directory every "
+						<< DELAY << " seconds.");
+				watcher.close();
+			}
+
+			//A file that is renamed in the directory must keep its
+			//offset, the events only has the names. The full scan
+			//finds the renamed file by the FileId.
+			for(std::map<std::string, uint32_t>::const_iterator it=events.files.begin();
+					it!=events.files.end() && !events.rescan; it++){
+				if(it->second & IN_MOVED_FROM)
+					events.rescan=true;
+			}
+		}else{
+			time(&tNow);
+
+			if((tNow-newObsCheckTime)<DELAY && !(pending &&
+					monotonicMs()-pendingCheckTime>=app.quietPeriod()))
+				usleep(timeout*1000);
+		}
+
+		time(&tNow);
+
+		if(events.rescan || (tNow-newObsCheckTime)>=
+				(watcher.ok()?app.rescanInterval():DELAY)){
+			newObsCheckTime=tNow;
+			pendingCheckTime=monotonicMs();
+			newObs=checkForNewObservations();
+
+			if(!watcher.ok() && app.useInotify() &&
+					(tNow-watchCheckTime)>=app.rescanInterval()){
+				watchCheckTime=tNow;
+				watcher.watch(dir_);
+			}
+		}else{
+			bool checkPending=pending &&
+					monotonicMs()-pendingCheckTime>=app.quietPeriod();
+
+			if(checkPending)
+				pendingCheckTime=monotonicMs();
+
+			if(checkPending || !events.empty())
+				newObs=checkForNewObservations(events, checkPending);
+		}
+
+		if(newObs){
+			collectObservations();
+			pipeline.saveFInfoList(dir_, fileInfoList);
+		}
+
+		pending=hasPendingFiles();
+	}
+
+	LOGDEBUG("Return from DirCollector: " << dir_);
+}
+
+bool
+DirCollector::getFileList(FileList &fileList)
+{
+	if(!scanner.scan(dir_, "", fileList)){
+		LOGERROR("Cant read directory <" << dir_ << ">! " << scanner.error());
+		return false;
+	}
+
+	if(!ignoreFilesBefore.is_neg_infinity()){
+		fileList.erase(std::remove_if(fileList.begin(), fileList.end(),
+				[this](const File &f){
+					return boost::posix_time::from_time_t(f.mtime()) < ignoreFilesBefore;
+				}),
+				fileList.end());
+	}
+
+	return !fileList.empty();
+}
+
+void
+DirCollector::collectObservations()
+{
+	TaskGroup tasks(pool);
+
+	LOGINFO("New observations to collect!");
+
+	//The files is collected in parallel, but a file is only in one
+	//task, so the reports from a file is sent in order. No entries is
+	//added or removed in fileInfoList before all tasks is done.
+	for(IFInfoList it=fileInfoList.begin();
+			it!=fileInfoList.end() && !app.inShutdown(); it++){
+		if(it->second.toBeCollected())
+			tasks.run([this, it]{ collectFile(it); });
+	}
+
+	tasks.wait();
+}
+
+void
+DirCollector::collectFile(IFInfoList it)
+{
+	const long RETRY_DELAY=3000;
+	MappedFile  buf;
+	std::string newObsPart;
+	std::string_view newObs;
+
+	if(it->second.inPlace()){
+		LOGINFO("Collect file: " << it->first << endl <<
+				"From offset: " << it->second.offset());
+
+		it->second.inPlace(false);
+
+		if(!readNewObsPart(it, newObsPart)){
+			it->second.seen(false);
+			it->second.collected(false);
+			it->second.retryLater(RETRY_DELAY);
+			return;
+		}
+
+		it->second.collected(true);
+
+		if(!newObsPart.empty()){
+			pipeline.doNewObs(it->first, std::move(newObsPart));
+		}
+	}else{
+		string fromfile(it->second.copy());
+
+		LOGINFO("Collect file: " << it->first << endl <<
+				"From the copy: " << fromfile);
+
+		if(it->second.copyLength()>=0?
+				!buf.load(fromfile, it->second.copyLength()):
+				!buf.open(fromfile)){
+			LOGERROR("Can't read the file: " << fromfile << ": " << strerror(errno));
+
+			if(!app.debug())
+				unlink(fromfile.c_str());
+
+			it->second.seen(false);
+			it->second.collected(false);
+			it->second.retryLater(RETRY_DELAY);
+			return;
+		}
+
+		File f(fromfile);
+
+		if(!f.ok()){
+			LOGERROR("Cant stat the file: " << fromfile );
+
+			it->second.removecopy(!app.debug());
+
+			it->second.seen(false);
+			it->second.collected(false);
+			it->second.retryLater(RETRY_DELAY);
+			return;
+		}
+
+		it->second.removecopy(!app.debug());
+
+		newObs=getNewObsPart(buf.view(), it);
+		it->second.collected(true);
+
+		if(!newObs.empty()){
+			pipeline.doNewObs(it->first, newObs);
+		}
+	}
+}
+
+std::string_view
+DirCollector::getNewObsPart(std::string_view obs, IFInfoList &it)
+{
+	std::string_view newObs;
+	unsigned int crc=0;
+	bool         crcValid=false;
+
+	if(it->second.offset()>0){
+		if(it->second.offset()<=static_cast<long>(obs.length())){
+			crc=crc_ccitt(obs.data(), it->second.offset());
+
+			if(crc==it->second.crc()){
+				newObs=obs.substr(it->second.offset());
+				crcValid=true;
+
+				if(newObs.empty()){
+					LOGDEBUG("New observation: No new data. " <<
+							"The file has only been touched.\n");
+				}else{
+					LOGDEBUG("New observations: appended to file!\n");
+				}
+			}else{
+				LOGDEBUG("New Observations: overwritten file!");
+				newObs=obs;
+			}
+		}else{
+			//The file is truncated.
+			LOGDEBUG("The file is truncated! (overwritten file)");
+			newObs=obs;
+		}
+	}else{
+		LOGDEBUG("New observations: New file!");
+		newObs=obs;
+	}
+
+	//Continue the crc of the unchanged part, if we have it.
+	if(crcValid)
+		crc=crc_ccitt(newObs.data(), newObs.size(), crc);
+	else
+		crc=crc_ccitt(obs.data(), obs.size());
+
+	it->second.offset(obs.length());
+	it->second.crc(crc);
+	it->second.clearTail();
+
+	return newObs;
+}
+
+namespace {
+/**
+ * Read \a len bytes from \a fd, starting at \a offset.
+ *
+ * \return false if we cant read all of it.
+ */
+bool
+preadAll(int fd, off_t offset, size_t len, std::string &buf)
+{
+	ssize_t n;
+	size_t  nRead=0;
+
+	buf.resize(len);
+
+	while(nRead<len){
+		n=pread(fd, &buf[nRead], len-nRead, offset+nRead);
+
+		if(n<0){
+			if(errno==EINTR)
+				continue;
+			return false;
+		}
+
+		if(n==0)
+			return false;
+
+		nRead+=n;
+	}
+
+	return true;
+}
+}
+
+bool
+DirCollector::readNewObsPart(IFInfoList &it, std::string &newObs)
+{
+	const long TAIL_FINGERPRINT=4096;
+	struct stat sbuf;
+	string      buf;
+	long        offset=it->second.offset();
+	long        tailLength;
+	bool        ok=false;
+	int         fd;
+
+	newObs.erase();
+	fd=open(it->first.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if(fd<0){
+		LOGERROR("Cant open the file: " << it->first << ": " << strerror(errno));
+		return false;
+	}
+
+	if(fstat(fd, &sbuf)<0){
+		LOGERROR("Cant stat the file: " << it->first << ": " << strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	FileId id(sbuf.st_dev, sbuf.st_ino);
+
+	if(offset>0 && offset<=sbuf.st_size &&
+			it->second.tailLength()>0 && it->second.tailId()==id){
+		if(!preadAll(fd, offset-it->second.tailLength(), it->second.tailLength(), buf)){
+			LOGERROR("Cant read the file: " << it->first);
+			close(fd);
+			return false;
+		}
+
+		if(crc_ccitt(buf.data(), buf.size())==it->second.tailCrc()){
+			//Only read the part of the file that is appended.
+			if(preadAll(fd, offset, sbuf.st_size-offset, newObs)){
+				if(newObs.empty()){
+					LOGDEBUG("New observation: No new data. " <<
+							"The file has only been touched.\n");
+				}else{
+					LOGDEBUG("New observations: appended to file!\n");
+				}
+
+				it->second.offset(sbuf.st_size);
+				it->second.crc(crc_ccitt(newObs.data(), newObs.size(), it->second.crc()));
+				ok=true;
+			}
+		}else{
+			LOGDEBUG("New Observations: overwritten file!");
+			offset=0;
+		}
+	}
+
+	if(!ok){
+		//We have no fingerprint of the part we have collected, or the
+		//file is overwritten. Read all of it.
+		if(!preadAll(fd, 0, sbuf.st_size, buf)){
+			LOGERROR("Cant read the file: " << it->first);
+			close(fd);
+			return false;
+		}
+
+		if(offset==0)
+			it->second.offset(0);
+
+		std::string_view part=getNewObsPart(buf, it);
+
+		//Move the new part to the front of buf. This is free when
+		//all of the file is new.
+		buf.erase(0, part.data()-buf.data());
+		newObs.swap(buf);
+	}
+
+	tailLength=sbuf.st_size<TAIL_FINGERPRINT?sbuf.st_size:TAIL_FINGERPRINT;
+
+	if(static_cast<long>(newObs.size())>=tailLength){
+		it->second.tail(id, crc_ccitt(newObs.data()+newObs.size()-tailLength, tailLength),
+		                tailLength);
+	}else if(preadAll(fd, sbuf.st_size-tailLength, tailLength, buf)){
+		it->second.tail(id, crc_ccitt(buf.data(), buf.size()), tailLength);
+	}else{
+		it->second.clearTail();
+	}
+
+	close(fd);
+	return true;
+}
+
+
+bool
+DirCollector::checkForNewObservations()
+{
+	FileList  &fileList=scanList;
+	IFileList it;
+	std::list<std::string> erased;
+	RenamedList renamed;
+	bool       hasNewFilesToCollect=false;
+
+	if(!getFileList(fileList)){
+		LOGINFO("No new observations!");
+		return false;
+	}
+
+	//We deletes all entries (files) in fileInfoList
+	//that no longer is in the directory. ie. all files
+	//that is in fileInfoList and not in fileList.
+
+	reconcileFInfoList(fileInfoList, fileList, erased, renamed);
+
+	BOOST_FOREACH(const std::string &name, erased){
+		LOGDEBUG("Erase <" << name << "> from fileInfoList\n");
+	}
+
+	BOOST_FOREACH(const RenamedList::value_type &r, renamed){
+		LOGDEBUG("Renamed <" << r.first << "> to <" << r.second << "> in fileInfoList\n");
+	}
+
+	//Checks if there is new files in the dierctory. Add
+	//them to the fileInfoList.
+
+	for(it=fileList.begin();
+			it!=fileList.end();
+			it++){
+		if(checkFile(*it, false))
+			hasNewFilesToCollect=true;
+	}
+
+	return hasNewFilesToCollect;
+}
+
+bool
+DirCollector::checkForNewObservations(const DirEvents &events, bool checkPending)
+{
+	std::map<std::string, uint32_t>::const_iterator eit;
+	std::list<std::string> pending;
+	IFInfoList fiIt;
+	bool       hasNewFilesToCollect=false;
+
+	for(eit=events.files.begin(); eit!=events.files.end(); eit++){
+		File f(eit->first);
+
+		if(!f.ok()){
+			fiIt=fileInfoList.find(eit->first);
+
+			if(fiIt!=fileInfoList.end()){
+				LOGDEBUG("Erase <" << eit->first << "> from fileInfoList\n");
+				fileInfoList.erase(fiIt);
+			}
+			continue;
+		}
+
+		if(!f.isFile() ||
+				boost::posix_time::from_time_t(f.mtime()) < ignoreFilesBefore)
+			continue;
+
+		//If the writer has closed the file or moved it into place we
+		//dont need to wait for it to be quiet.
+		if(checkFile(f, eit->second & (IN_CLOSE_WRITE | IN_MOVED_TO)))
+			hasNewFilesToCollect=true;
+	}
+
+	if(!checkPending)
+		return hasNewFilesToCollect;
+
+	//Files we know about, but has not collected yet, must be checked
+	//again to find out if they have been left alone by the writer.
+	for(fiIt=fileInfoList.begin(); fiIt!=fileInfoList.end(); fiIt++){
+		if(!fiIt->second.collected() && events.files.find(fiIt->first)==events.files.end())
+			pending.push_back(fiIt->first);
+	}
+
+	BOOST_FOREACH(const std::string &name, pending){
+		File f(name);
+
+		if(!f.ok()){
+			LOGDEBUG("Erase <" << name << "> from fileInfoList\n");
+			fileInfoList.erase(name);
+			continue;
+		}
+
+		if(checkFile(f, false))
+			hasNewFilesToCollect=true;
+	}
+
+	return hasNewFilesToCollect;
+}
+
+bool
+DirCollector::hasPendingFiles()const
+{
+	for(CIFInfoList it=fileInfoList.begin(); it!=fileInfoList.end(); it++){
+		if(!it->second.collected())
+			return true;
+	}
+
+	return false;
+}
+
+bool
+DirCollector::checkFile(const File &file, bool writeClosed)
+{
+	IFInfoList fiIt=fileInfoList.find(file.name());
+
+	if(fiIt==fileInfoList.end()){
+		LOGDEBUG("New entrie: <" << file.name()
+				<< "> in fileInfoList\n");
+		fiIt=fileInfoList.insert(make_pair(file.name(), FInfo(file))).first;
+		fiIt->second.update(file);
+	}else if(fiIt->second.changed(file)){
+		LOGDEBUG("New mtime: <" << file.name() << ">");
+		fiIt->second.update(file);
+		fiIt->second.seen(false);
+		fiIt->second.collected(false);
+	}
+
+	if(fiIt->second.collected() || fiIt->second.seen())
+		return fiIt->second.toBeCollected();
+
+	if(writeClosed){
+		LOGDEBUG("Closed by the writer: <" << file.name() << ">\n");
+	}else if(fiIt->second.quiet(app.quietPeriod())){
+		LOGDEBUG("Unchanged for " << app.quietPeriod() << " ms: <" << file.name() << ">\n");
+	}else{
+		return false;
+	}
+
+	fiIt->second.seen(true);
+	fiIt=readyToCollect(fileInfoList, fiIt);
+
+	if(fiIt==fileInfoList.end() || !fiIt->second.toBeCollected())
+		return false;
+
+	LOGINFO("New observation in file: " << fiIt->second.name()
+			<< endl << "A copy of the file is: " <<
+			fiIt->second.copy());
+	return true;
+}
+
+
+IFInfoList
+DirCollector::
+readyToCollect(FInfoList &infoList, IFInfoList it)
+{
+	if(!app.tailRead())
+		return copyFile(infoList, it);
+
+	it->second.removecopy(!app.debug());
+	it->second.inPlace(true);
+	return it;
+}
+
+IFInfoList 
+DirCollector::
+copyFile(FInfoList &infoList, IFInfoList it)
+{
+	File oldfile(it->second.file());
+	miTime now(miTime::nowTime());
+	char buf[32];
+
+	sprintf(buf, "_%04d%02d%02dT%02d%02d%02d",
+			now.year(), now.month(), now.day(),
+			now.hour(), now.min(), now.sec());
+
+	string tofile=app.tmpdir()+tmpPrefix_+it->second.namepart()+buf;
+
+	//If the file has grown since it was last collected we assume it
+	//is only appended to, and a hardlink will do as a snapshot.
+	bool appendOnly=it->second.offset()>0 &&
+			it->second.file().size()>=it->second.offset();
+	off_t size;
+	snapshot::Method method=snapshot::takeSnapshot(it->second.name(), tofile,
+	                                               appendOnly, size);
+
+	LOGDEBUG("Copysynopfile: " << it->second.name() << endl <<
+			"-----------to: " << tofile << " (" << snapshot::methodToString(method) << ")");
+
+	if(method==snapshot::FAILED){
+		LOGWARN("Cant copy synopfile: " << it->second.name() << endl <<
+				"---------------- to: " << tofile <<
+				"Removing <"<< it->second.name() <<"> from InfoList!");
+		infoList.erase(it);
+		return infoList.end();
+	}
+
+	try{
+		it->second.mtimeNow();
+	}
+	catch(FInfo::StatException &ex){
+		LOGINFO("The synop file has gone: " << it->second.name());
+		infoList.erase(it);
+		return infoList.end();
+	}
+
+	if(it->second.changed(oldfile)){
+		it->second.update(it->second.file());
+		LOGDEBUG("Synopfile: <" << it->second.name() <<
+				"> has changed after copy!" << endl <<
+				"Removing copy: " << tofile);
+		unlink(tofile.c_str());
+		it->second.seen(false);
+		it->second.collected(false);
+	}else{
+		it->second.removecopy(!app.debug());
+
+		it->second.copy(tofile, method==snapshot::HARDLINK?size:-1);
+	}
+
+	return it;
+}
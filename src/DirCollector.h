@@ -0,0 +1,194 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __DirCollector_h__
+#define __DirCollector_h__
+
+#include <string>
+#include <string_view>
+#include <thread>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "App.h"
+#include "FInfo.h"
+#include "File.h"
+#include "DirWatcher.h"
+#include "DirScanner.h"
+#include "WorkerPool.h"
+
+class CollectWmoReports;
+
+/**
+ * Collect the new observations in one of the synopdirs.
+ *
+ * A DirCollector runs in its own thread, and has its own
+ * FInfoList, watcher and scanner for the directory. The
+ * new part of the files is handed over to the pipeline in
+ * CollectWmoReports, that is shared between all the
+ * directories.
+ */
+class DirCollector
+{
+	DirCollector(const DirCollector&);
+	DirCollector& operator=(const DirCollector&);
+
+	App                      &app;
+	CollectWmoReports        &pipeline;
+	WorkerPool               *pool;
+	std::string              dir_;
+	std::string              tmpPrefix_;
+	FInfoList                fileInfoList;
+	DirScanner               scanner;
+	FileList                 scanList; //Reused between the scans of dir_.
+	boost::posix_time::ptime ignoreFilesBefore;
+	std::thread              thread_;
+
+	void run();
+
+	bool getFileList(FileList &fileList);
+
+	bool checkForNewObservations();
+
+	/**
+	 * Check the files in \a events, and if \a checkPending is true,
+	 * the files we know has changed, but is not collected yet. The
+	 * rest of the directory is not scanned.
+	 */
+	bool checkForNewObservations(const DirEvents &events, bool checkPending);
+
+	/**
+	 * Is there files we have seen change, but not collected yet.
+	 */
+	bool hasPendingFiles()const;
+
+	/**
+	 * Update the fileInfoList with the state of \a file.
+	 *
+	 * \param file The file to check.
+	 * A file is ready to be collected when it has been unchanged, both
+	 * mtime and size, for the quiet period, or we know the writer is
+	 * finished with it.
+	 *
+	 * \param writeClosed true if we know the writer is finished with the file,
+	 *        ie. we have got an IN_CLOSE_WRITE or IN_MOVED_TO event for it.
+	 * \return true if the file is ready to be collected.
+	 */
+	bool checkFile(const File &file, bool writeClosed);
+
+	/**
+	 * Collect the files that is ready to be collected. The files is
+	 * collected in parallel by the WorkerPool, if we have one.
+	 */
+	void collectObservations();
+
+	/**
+	 * Read the new part of the file \a it and send it to the pipeline.
+	 * Only the FInfo in \a it is updated, so it is safe to collect
+	 * different files at the same time.
+	 */
+	void collectFile(IFInfoList it);
+
+	/**
+	 * Find the part of \a obs that is new since the file was last
+	 * collected. The offset and crc in \a it is updated.
+	 *
+	 * \return a view into \a obs.
+	 */
+	std::string_view getNewObsPart(std::string_view obs,
+	                               IFInfoList &it);
+
+	/**
+	 * Read the part of the file that is appended since it was last
+	 * collected, directly from the file. The part of the file we
+	 * already have collected is checked against the tail fingerprint
+	 * in the FInfo, if it does not match the file is overwritten and
+	 * all of it is returned.
+	 *
+	 * \param it The file to read.
+	 * \param[out] newObs The new part of the file.
+	 * \return false if the file can't be read.
+	 */
+	bool readNewObsPart(IFInfoList &it, std::string &newObs);
+
+	/**
+	 * copy a synopfile to the tmpdir. Check if the source file
+	 * has changed after the copy, if it has changed remove the
+	 * copy and set the collected flag to false and the seen count to 0.
+	 *
+	 * If we cant copy the file, remove the file from the InfoList. We
+	 * assume the file has been deleted.
+	 *
+	 * \param infoList A referance to the infolist.
+	 * \param it an iterator to an element in infoList.
+	 * \return An iteretor to infoList.end() if the file referenced by
+	 *         it is deleted and the iterator it otherwise.
+	 */
+	IFInfoList copyFile(FInfoList &infoList, IFInfoList it);
+
+	/**
+	 * Mark the file as ready to be collected. With tail_read the file
+	 * is read where it is, otherwise it is copied to the tmpdir with
+	 * copyFile.
+	 *
+	 * \return As for copyFile.
+	 */
+	IFInfoList readyToCollect(FInfoList &infoList, IFInfoList it);
+
+public:
+	/**
+	 * \param app The application.
+	 * \param pipeline Where the new observations is sent.
+	 * \param pool The workers that collects the files, or 0 to
+	 *        collect them in the DirCollector thread.
+	 * \param dir The directory to collect from, it must end with a '/'.
+	 * \param tmpPrefix Prepended to the name of the copies in tmpdir, so
+	 *        files with the same name in different directories do not
+	 *        collide.
+	 * \param fileInfoList The files we know about in \a dir, from the
+	 *        state file.
+	 */
+	DirCollector(App &app, CollectWmoReports &pipeline,
+	             WorkerPool *pool,
+	             const std::string &dir, const std::string &tmpPrefix,
+	             const FInfoList &fileInfoList);
+	~DirCollector();
+
+	std::string dir()const{ return dir_;}
+
+	/**
+	 * Start the thread that collects from the directory. The thread
+	 * runs until App::inShutdown() is true.
+	 */
+	void start();
+
+	/**
+	 * Wait for the thread to terminate.
+	 */
+	void join();
+};
+
+#endif
@@ -0,0 +1,108 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <string.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include "DirScanner.h"
+
+namespace {
+const size_t BUFSIZE=64*1024;
+
+struct linux_dirent64 {
+	uint64_t       d_ino;
+	int64_t        d_off;
+	unsigned short d_reclen;
+	unsigned char  d_type;
+	char           d_name[];
+};
+}
+
+DirScanner::DirScanner()
+	:buf_(BUFSIZE)
+{
+}
+
+bool
+DirScanner::scan(const std::string &path, const std::string &pattern,
+                 FileList &files)
+{
+	struct stat sbuf;
+	size_t nFiles=0;
+	long   n;
+	int    fd;
+
+	error_.erase();
+	fd=open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if(fd<0){
+		error_=strerror(errno);
+		files.clear();
+		return false;
+	}
+
+	while((n=syscall(SYS_getdents64, fd, &buf_[0], buf_.size()))>0){
+		for(long pos=0; pos<n; ){
+			const linux_dirent64 *ent=reinterpret_cast<const linux_dirent64*>(&buf_[pos]);
+			pos+=ent->d_reclen;
+
+			//Symbolic links must be followed and some filesystems
+			//dont fill in d_type, they must be stat'ed to find out
+			//if they are regular files.
+			if(ent->d_type!=DT_REG && ent->d_type!=DT_LNK && ent->d_type!=DT_UNKNOWN)
+				continue;
+
+			if(!pattern.empty() && fnmatch(pattern.c_str(), ent->d_name, 0)!=0)
+				continue;
+
+			if(fstatat(fd, ent->d_name, &sbuf, 0)<0 || !S_ISREG(sbuf.st_mode))
+				continue;
+
+			if(nFiles<files.size())
+				files[nFiles].set(path, ent->d_name, sbuf);
+			else
+				files.push_back(File(path+ent->d_name, sbuf));
+
+			++nFiles;
+		}
+	}
+
+	if(n<0)
+		error_=strerror(errno);
+
+	close(fd);
+	files.resize(nFiles);
+	return n==0;
+}
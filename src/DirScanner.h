@@ -0,0 +1,74 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __DirScanner_h__
+#define __DirScanner_h__
+
+#include <string>
+#include <vector>
+#include "File.h"
+
+/**
+ * Scan a directory for regular files with few system calls.
+ *
+ * The directory entries is read in bulk with getdents64 against
+ * one directory file descriptor. Entries that is not regular files
+ * is skipped by looking at d_type, and only the candidates is
+ * stat'ed, with fstatat relative to the directory.
+ *
+ * The buffers is kept between the scans, so a DirScanner should be
+ * reused for repeated scans of a directory.
+ */
+class DirScanner
+{
+	DirScanner(const DirScanner&);
+	DirScanner& operator=(const DirScanner&);
+
+	std::vector<char> buf_;
+	std::string       error_;
+
+public:
+	DirScanner();
+
+	/**
+	 * Find the regular files in the directory \a path that matches
+	 * \a pattern. Symbolic links to regular files is followed.
+	 *
+	 * \param path The directory to scan, it must end with a '/'.
+	 * \param pattern A shell wildcard pattern (fnmatch), all files
+	 *        if empty.
+	 * \param[out] files The files found. The elements in it is reused.
+	 * \return false if the directory can't be read. files is then empty.
+	 */
+	bool scan(const std::string &path, const std::string &pattern,
+	          FileList &files);
+
+	std::string error()const{ return error_;}
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <milog/milog.h>
+#include "DirWatcher.h"
+#include "App.h"
+
+namespace {
+const uint32_t WATCH_MASK=IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_MOVED_FROM |
+                          IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF;
+}
+
+DirWatcher::DirWatcher()
+	:fd_(-1), wd_(-1)
+{
+}
+
+DirWatcher::~DirWatcher()
+{
+	close();
+}
+
+bool
+DirWatcher::watch(const std::string &dir)
+{
+	close();
+	dir_=fixPath(dir);
+
+	fd_=inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if(fd_<0){
+		LOGWARN("inotify: Cant initialize inotify: " << strerror(errno));
+		return false;
+	}
+
+	wd_=inotify_add_watch(fd_, dir_.c_str(), WATCH_MASK | IN_ONLYDIR);
+
+	if(wd_<0){
+		LOGWARN("inotify: Cant watch the directory <" << dir_ << ">: " << strerror(errno));
+		close();
+		return false;
+	}
+
+	LOGINFO("inotify: watching the directory <" << dir_ << ">.");
+	return true;
+}
+
+void
+DirWatcher::close()
+{
+	if(fd_>=0)
+		::close(fd_);
+
+	fd_=-1;
+	wd_=-1;
+}
+
+int
+DirWatcher::wait(int timeoutMs, DirEvents &events)
+{
+	char buf[16*1024] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	struct pollfd pfd;
+	int count=0;
+	ssize_t n;
+
+	if(!ok())
+		return -1;
+
+	pfd.fd=fd_;
+	pfd.events=POLLIN;
+	pfd.revents=0;
+
+	n=poll(&pfd, 1, timeoutMs);
+
+	if(n<0)
+		return errno==EINTR?0:-1;
+
+	if(n==0)
+		return 0;
+
+	while(true){
+		n=read(fd_, buf, sizeof(buf));
+
+		if(n<0){
+			if(errno==EINTR)
+				continue;
+
+			if(errno==EAGAIN)
+				break;
+
+			LOGERROR("inotify: read failed: " << strerror(errno));
+			return -1;
+		}
+
+		for(char *p=buf; p<buf+n; ){
+			const struct inotify_event *ev=reinterpret_cast<const struct inotify_event*>(p);
+			p+=sizeof(struct inotify_event)+ev->len;
+			++count;
+
+			if(ev->mask & IN_Q_OVERFLOW){
+				events.rescan=true;
+				continue;
+			}
+
+			if(ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)){
+				LOGWARN("inotify: lost the watch on <" << dir_ << ">.");
+				events.rescan=true;
+				wd_=-1;
+				continue;
+			}
+
+			if(ev->len==0 || (ev->mask & IN_ISDIR))
+				continue;
+
+			events.files[dir_+ev->name] |= ev->mask;
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,91 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __DirWatcher_h__
+#define __DirWatcher_h__
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+/**
+ * The events collected by DirWatcher::wait. The events for a file
+ * is coalesced into one inotify mask.
+ */
+struct DirEvents {
+	std::map<std::string, uint32_t> files; //Full path -> inotify mask.
+	bool rescan; //The event queue has overflowed or the watch is lost.
+
+	DirEvents():rescan(false){}
+	void clear(){ files.clear(); rescan=false; }
+	bool empty()const{ return files.empty() && !rescan; }
+};
+
+/**
+ * Watch a directory for changes with inotify.
+ *
+ * Only the events that is of interest for norcom2kv is
+ * watched, ie. IN_CLOSE_WRITE, IN_MODIFY, IN_MOVED_TO, IN_MOVED_FROM
+ * and IN_DELETE.
+ */
+class DirWatcher
+{
+	DirWatcher(const DirWatcher&);
+	DirWatcher& operator=(const DirWatcher&);
+
+	int         fd_;
+	int         wd_;
+	std::string dir_;
+
+public:
+	DirWatcher();
+	~DirWatcher();
+
+	/**
+	 * Start watching the directory \a dir.
+	 *
+	 * \return true on success and false if the watch could not be set up,
+	 *         ie. inotify is not supported.
+	 */
+	bool watch(const std::string &dir);
+	void close();
+
+	bool ok()const{ return fd_>=0 && wd_>=0;}
+	std::string dir()const{ return dir_;}
+
+	/**
+	 * Wait at most \a timeoutMs milliseconds for events in the directory.
+	 *
+	 * \param timeoutMs Max time to wait, in milliseconds.
+	 * \param[out] events The events that is received is added to events.
+	 * \return the number of events received, 0 on timeout and -1 on error.
+	 */
+	int wait(int timeoutMs, DirEvents &events);
+};
+
+#endif
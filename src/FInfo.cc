@@ -0,0 +1,82 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <unordered_map>
+#include "FInfo.h"
+
+void
+reconcileFInfoList(FInfoList &infoList, const FileList &fileList,
+                   std::list<std::string> &erased, RenamedList &renamed)
+{
+	std::unordered_map<std::string, const File*> names;
+	std::unordered_map<FileId, const File*, FileIdHash> ids;
+	std::unordered_map<std::string, const File*>::const_iterator nit;
+	std::unordered_map<FileId, const File*, FileIdHash>::const_iterator iit;
+	IFInfoList it=infoList.begin();
+	IFInfoList tmpIt;
+
+	erased.clear();
+	renamed.clear();
+
+	names.reserve(fileList.size());
+	ids.reserve(fileList.size());
+
+	for(CIFileList fit=fileList.begin(); fit!=fileList.end(); fit++){
+		names[fit->name()]=&*fit;
+		ids[fit->id()]=&*fit;
+	}
+
+	while(it!=infoList.end()){
+		tmpIt=it;
+		it++;
+
+		if(names.find(tmpIt->first)!=names.end())
+			continue;
+
+		iit=ids.find(tmpIt->second.id());
+
+		if(iit!=ids.end() && tmpIt->second.id()!=FileId() &&
+				infoList.find(iit->second->name())==infoList.end()){
+			const File &f=*iit->second;
+			FInfo fi(f, tmpIt->second.offset(), tmpIt->second.crc(),
+			         tmpIt->second.collected(), tmpIt->second.seen());
+
+			fi.copy(tmpIt->second.copy(), tmpIt->second.copyLength());
+			fi.inPlace(tmpIt->second.inPlace());
+			fi.tail(tmpIt->second.tailId(), tmpIt->second.tailCrc(),
+			        tmpIt->second.tailLength());
+			renamed.push_back(make_pair(tmpIt->first, f.name()));
+			infoList.erase(tmpIt);
+			infoList.insert(make_pair(f.name(), fi));
+			continue;
+		}
+
+		erased.push_back(tmpIt->first);
+		infoList.erase(tmpIt);
+	}
+}
@@ -33,20 +33,37 @@
 
 #include <time.h>
 #include <map>
+#include <list>
 #include <string>
 #include <exception>
 #include <unistd.h>
 #include "File.h"
 
+/**
+ * Milliseconds from CLOCK_MONOTONIC.
+ */
+inline long long
+monotonicMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<long long>(ts.tv_sec)*1000+ts.tv_nsec/1000000;
+}
+
 class FInfo{
   	File          file_;
   	time_t        mtime_;
   	long          offset_;
   	unsigned int crc_;
   	bool          collected_;
-  	bool          seen_; //Have the file been seen before with the collected
-                      //flag set to false.
+  	bool          seen_; //The file is stable, ie. the writer is done with it.
+  	long long     changedAt_; //monotonicMs() when we saw the file change.
+  	bool          inPlace_; //Collect from the file itself and not from a copy.
   	std::string  fcopy;
+  	long          copyLength_; //The valid part of fcopy, -1 if all of it.
+  	FileId        tailId_;     //The file the tail fingerprint is computed for.
+  	unsigned int  tailCrc_;    //crc of the tailLength_ bytes before offset_.
+  	long          tailLength_; //0 if we have no tail fingerprint.
 
  	public:
 
@@ -63,7 +80,8 @@ class FInfo{
       
 
   	FInfo():
-    	mtime_(0), offset_(0), crc_(0), collected_(false), seen_(false){}
+    	mtime_(0), offset_(0), crc_(0), collected_(false), seen_(false),
+    	changedAt_(0), inPlace_(false), copyLength_(-1), tailCrc_(0), tailLength_(0){}
 
   	FInfo(const File &f, long offset=0, 
 		  unsigned int           crc=0, 
@@ -74,12 +92,20 @@ class FInfo{
     	offset_(offset), 
     	crc_(crc),
     	collected_(collected),
-    	seen_(seen){}
+    	seen_(seen),
+    	changedAt_(0),
+    	inPlace_(false),
+    	copyLength_(-1),
+    	tailCrc_(0),
+    	tailLength_(0){}
  
 
   	FInfo(const FInfo& f):
-    	file_(f.file_), offset_(f.offset_), crc_(f.crc_), 
-    	collected_(f.collected_), seen_(f.seen_){}
+    	file_(f.file_), mtime_(f.mtime_), offset_(f.offset_), crc_(f.crc_), 
+    	collected_(f.collected_), seen_(f.seen_), changedAt_(f.changedAt_),
+    	inPlace_(f.inPlace_),
+    	fcopy(f.fcopy), copyLength_(f.copyLength_), tailId_(f.tailId_), tailCrc_(f.tailCrc_),
+    	tailLength_(f.tailLength_){}
   
   	FInfo& operator=(const FInfo &rhs){
       	if(this!=&rhs){
@@ -89,6 +115,13 @@ class FInfo{
 			crc_      =rhs.crc_;
 			collected_=rhs.collected_;
 			seen_     =rhs.seen_;
+			changedAt_=rhs.changedAt_;
+			inPlace_  =rhs.inPlace_;
+			fcopy     =rhs.fcopy;
+			copyLength_=rhs.copyLength_;
+			tailId_   =rhs.tailId_;
+			tailCrc_  =rhs.tailCrc_;
+			tailLength_=rhs.tailLength_;
       	}
 
       	return *this;
@@ -104,18 +137,58 @@ class FInfo{
   	void   collected(bool c){ collected_=c;}
 
   	std::string copy()const{ return fcopy;}
-  	void  copy(const std::string &copy_){ fcopy=copy_; }
+  	void  copy(const std::string &copy_, long length=-1){ fcopy=copy_; copyLength_=length; }
+
+  	/**
+  	 * The number of bytes in the copy that belongs to the snapshot,
+  	 * or -1 if all of it. It is only set when the copy is a
+  	 * hardlink to a file that is appended to.
+  	 */
+  	long  copyLength()const{ return copyLength_;}
   	void  removecopy(bool removefile){ 
     			if(!fcopy.empty()){
     				 if(removefile)
 		   				unlink(fcopy.c_str());
 		   			fcopy.erase();
+		   			copyLength_=-1;
 		  		}
           }
           
-  	bool   toBeCollected(){ return !collected_ && seen_ && !fcopy.empty();}
+  	bool   inPlace()const{ return inPlace_;}
+  	void   inPlace(bool flag){ inPlace_=flag;}
+
+  	bool   toBeCollected(){ return !collected_ && seen_ && (inPlace_ || !fcopy.empty());}
   
   	time_t mtime()const { return mtime_;}
+
+  	/**
+  	 * Has the file changed, ie. is the mtime, with nanosecond resolution,
+  	 * or the size of \a f different from what we know.
+  	 */
+  	bool   changed(const File &f)const{
+  		return file_.mtimeNs()!=f.mtimeNs() || file_.size()!=f.size();
+  	}
+
+  	/**
+  	 * Update with the new state \a f of the file and remember
+  	 * when the change was seen.
+  	 */
+  	void   update(const File &f){
+  		file_=f;
+  		mtime_=f.mtime();
+  		changedAt_=monotonicMs();
+  	}
+
+  	/**
+  	 * Has the file been left alone for at least \a ms milliseconds.
+  	 */
+  	bool   quiet(long ms)const{ return monotonicMs()-changedAt_>=ms;}
+
+  	/**
+  	 * We failed to collect the file. Dont regard it as quiet
+  	 * until \a ms milliseconds has passed.
+  	 */
+  	void   retryLater(long ms){ changedAt_=monotonicMs()+ms;}
   
   	/** Do a stat request on the file!
    	 * 
@@ -134,7 +207,22 @@ class FInfo{
   	unsigned int crc()const { return crc_;}
   	void          crc(unsigned int c){ crc_=c;}
 
+  	/**
+  	 * A fingerprint of the last \a length bytes before offset. It is
+  	 * used to check that the part of the file we have collected is
+  	 * unchanged, without reading all of it.
+  	 */
+  	void tail(const FileId &id, unsigned int crc, long length){
+  		tailId_=id; tailCrc_=crc; tailLength_=length;
+  	}
+  	void          clearTail(){ tailLength_=0;}
+  	FileId        tailId()const{ return tailId_;}
+  	unsigned int tailCrc()const{ return tailCrc_;}
+  	long          tailLength()const{ return tailLength_;}
+
   	std::string  name()const{ return file_.name();}
+  	const File&  file()const{ return file_;}
+  	FileId       id()const{ return file_.id();}
   	std::string  basepart()const { return file_.basepart();}
   	std::string  namepart()const { return file_.namepart();}
 };
@@ -143,6 +231,27 @@ typedef std::map<std::string, FInfo>                   FInfoList;
 typedef std::map<std::string, FInfo>::iterator        IFInfoList;  
 typedef std::map<std::string, FInfo>::const_iterator CIFInfoList;  
 
+typedef std::list<std::pair<std::string, std::string> > RenamedList;
+
+/**
+ * Remove the entries in \a infoList for files that no longer is in
+ * the directory listing \a fileList.
+ *
+ * A file that has been renamed within the directory is found by
+ * its device and inode number. It keeps its offset and crc, but is
+ * moved to the new name.
+ *
+ * The cost is linear in the size of \a infoList and \a fileList.
+ *
+ * \param infoList The list to update.
+ * \param fileList The files in the directory.
+ * \param[out] erased The names of the entries that is removed.
+ * \param[out] renamed The (old, new) names of the entries that is renamed.
+ */
+void
+reconcileFInfoList(FInfoList &infoList, const FileList &fileList,
+                   std::list<std::string> &erased, RenamedList &renamed);
+
 
 
 
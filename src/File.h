@@ -35,6 +35,29 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string>
+#include <vector>
+#include <functional>
+
+/**
+ * Identify a file by device and inode number.
+ */
+struct FileId{
+	dev_t dev;
+	ino_t ino;
+
+	FileId():dev(0), ino(0){}
+	FileId(dev_t d, ino_t i):dev(d), ino(i){}
+
+	bool operator==(const FileId &rhs)const{ return dev==rhs.dev && ino==rhs.ino;}
+	bool operator!=(const FileId &rhs)const{ return !(*this==rhs);}
+};
+
+struct FileIdHash{
+	size_t operator()(const FileId &id)const{
+		return std::hash<unsigned long long>()(
+				(static_cast<unsigned long long>(id.dev)<<40) ^ id.ino);
+	}
+};
 
 class File{
   	std::string name_;
@@ -49,7 +72,7 @@ class File{
       		name_.erase();
   	}
     
-  	File(const std::string &name, struct stat &stat):
+  	File(const std::string &name, const struct stat &stat):
     	name_(name), stat_(stat){
     }
 
@@ -67,6 +90,16 @@ class File{
       	return *this;
     }
 
+  	/**
+  	 * Set the name to \a dir followed by \a name. The memory
+  	 * already allocated for the name is reused.
+  	 */
+  	void set(const std::string &dir, const char *name, const struct stat &stat){
+  		name_.assign(dir);
+  		name_.append(name);
+  		stat_=stat;
+  	}
+
   	bool ok()const{ return !name_.empty();}
 
   	bool reStat(){ 
@@ -85,6 +118,8 @@ class File{
   	std::string name()const{ return name_;}
   
   	time_t      mtime()const{ return (name_.empty()?0:stat_.st_mtime);}
+  	long long   mtimeNs()const{ return (name_.empty()?0:
+  	                    static_cast<long long>(stat_.st_mtim.tv_sec)*1000000000LL+stat_.st_mtim.tv_nsec);}
   	time_t      atime()const{ return (name_.empty()?0:stat_.st_atime);}
   	time_t      ctime()const{ return (name_.empty()?0:stat_.st_ctime);}
   	off_t       size()const { return (name_.empty()?0:stat_.st_size);}
@@ -92,6 +127,7 @@ class File{
   	gid_t       gid()const  { return (name_.empty()?0:stat_.st_gid);}
   	mode_t      mode()const { return (name_.empty()?0:stat_.st_mode);}
   	nlink_t     nlink()const{ return (name_.empty()?0:stat_.st_nlink);}
+  	FileId      id()const   { return (name_.empty()?FileId():FileId(stat_.st_dev, stat_.st_ino));}
 
   	bool       isFile()const    { return S_ISREG(mode());}
   	bool       isDir()const     { return S_ISDIR(mode());}
@@ -100,4 +136,8 @@ class File{
   	bool       isSocket()const  { return S_ISSOCK(mode());}
 };
 
+typedef std::vector<File>                   FileList;
+typedef std::vector<File>::iterator        IFileList;
+typedef std::vector<File>::const_iterator CIFileList;
+
 #endif
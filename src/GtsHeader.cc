@@ -0,0 +1,133 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "GtsHeader.h"
+
+namespace {
+
+static_assert( wmoraport::detail::t1t2Table( 'S', 'M' ) == wmoraport::SYNOP );
+static_assert( wmoraport::detail::t1t2Table( 'F', 'T' ) == wmoraport::detail::T1T2Table::UNKNOWN );
+
+constexpr bool
+isClassifiedAs( std::string_view ttaaii, wmoraport::WmoRaport type )
+{
+	wmoraport::WmoRaport t=wmoraport::SYNOP;
+	return wmoraport::classify( ttaaii, t ) && t == type;
+}
+
+static_assert( isClassifiedAs( "SAXX01", wmoraport::METAR ) );
+static_assert( isClassifiedAs( "ISRZ01", wmoraport::TIDE ) );
+static_assert( isClassifiedAs( "ISND20", wmoraport::BUFR_SURFACE ) );
+static_assert( ! isClassifiedAs( "ISRA01", wmoraport::TIDE ) );
+
+//As \w and \d in the regular expressions, in the C locale.
+inline bool
+isWord( char ch )
+{
+	return ( ch >= 'a' && ch <= 'z' ) || ( ch >= 'A' && ch <= 'Z' ) ||
+			( ch >= '0' && ch <= '9' ) || ch == '_';
+}
+
+inline bool
+isDigit( char ch )
+{
+	return ch >= '0' && ch <= '9';
+}
+
+inline bool
+isSpace( char ch )
+{
+	return ch == ' ';
+}
+
+template<typename Pred>
+size_t
+skipWhile( std::string_view line, size_t i, Pred pred )
+{
+	while( i < line.size() && pred( line[i] ) )
+		++i;
+	return i;
+}
+
+}
+
+namespace wmoraport {
+
+bool
+parseGtsHeader( std::string_view line, GtsHeader &header )
+{
+	size_t i=skipWhile( line, 0, isSpace );
+	size_t b;
+
+	header.line=line;
+	header.known=false;
+
+	//TTAAii
+	if( line.size() - i < 6 )
+		return false;
+
+	for( b=i; i < b + 6; ++i )
+		if( ! isWord( line[i] ) )
+			return false;
+
+	header.ttaaii=line.substr( b, 6 );
+
+	if( i >= line.size() || line[i] != ' ' )
+		return false;
+
+	//CCCC
+	b=skipWhile( line, i, isSpace );
+	i=skipWhile( line, b, isWord );
+
+	if( i == b || i >= line.size() || line[i] != ' ' )
+		return false;
+
+	header.cccc=line.substr( b, i - b );
+
+	//YYGGgg
+	b=skipWhile( line, i, isSpace );
+	i=skipWhile( line, b, isDigit );
+
+	if( i == b )
+		return false;
+
+	header.yygggg=line.substr( b, i - b );
+
+	//BBB
+	b=skipWhile( line, i, isSpace );
+	i=skipWhile( line, b, isWord );
+
+	if( i != line.size() )
+		return false;
+
+	header.bbb=line.substr( b, i - b );
+	header.known=classify( header.ttaaii, header.type );
+	return true;
+}
+
+}
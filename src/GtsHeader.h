@@ -0,0 +1,151 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __GtsHeader_h__
+#define __GtsHeader_h__
+
+#include <string_view>
+#include "WMORaport.h"
+
+namespace wmoraport {
+
+/**
+ * The abbreviated heading of a GTS bulletin, 'TTAAii CCCC YYGGgg [BBB]'.
+ * The fields is views into the line the heading is parsed from.
+ */
+struct GtsHeader {
+	std::string_view line;   ///< The whole heading line.
+	std::string_view ttaaii; ///< Data type and area, ie. SMNO01.
+	std::string_view cccc;   ///< The originating station, ie. ENMI.
+	std::string_view yygggg; ///< Day and time, ie. 011200.
+	std::string_view bbb;    ///< Empty or the indicator RRx, CCx or AAx.
+	WmoRaport        type;   ///< Only valid if known is true.
+	bool             known;  ///< Is this a report type we decode.
+};
+
+namespace detail {
+
+/**
+ * The report type for a T1T2 pair, indexed by T1-'A' and T2-'A'. The
+ * types that need A1 (and A2) to be decided is marked BY_A1.
+ */
+class T1T2Table
+{
+public:
+	enum { UNKNOWN=-1, BY_A1=-2 };
+
+private:
+	signed char type_[26][26];
+
+	constexpr void set( char t1, const char *t2, int type ) {
+		for( ; *t2; ++t2 )
+			type_[t1-'A'][*t2-'A']=type;
+	}
+
+public:
+	constexpr T1T2Table(): type_{} {
+		for( auto &row : type_ )
+			for( auto &t : row )
+				t=UNKNOWN;
+
+		set( 'S', "IMN",     SYNOP );
+		set( 'S', "AP",      METAR );
+		set( 'U', "EFKLMSZ", TEMP );
+		set( 'U', "GHIPQY",  PILO );
+		set( 'U', "AD",      AREP );
+		set( 'S', "S",       DRAU );
+		set( 'S', "O",       BATH );
+		set( 'I', "S",       BY_A1 );
+	}
+
+	constexpr int operator()( char t1, char t2 )const {
+		if( t1 < 'A' || t1 > 'Z' || t2 < 'A' || t2 > 'Z' )
+			return UNKNOWN;
+		return type_[t1-'A'][t2-'A'];
+	}
+};
+
+inline constexpr T1T2Table t1t2Table;
+}
+
+/**
+ * Classify a report from the TTAAii in the GTS heading:
+ *
+ *    SI,SM,SN             -> SYNOP
+ *    SA,SP                -> METAR
+ *    UE,UF,UK,UL,UM,US,UZ -> TEMP
+ *    UG,UH,UI,UP,UQ,UY    -> PILO
+ *    UA,UD                -> AREP
+ *    SS                   -> DRAU
+ *    SO                   -> BATH
+ *    ISRZ                 -> TIDE
+ *    ISI,ISM,ISN          -> BUFR_SURFACE
+ *
+ * \param ttaaii At least the four characters TTAA.
+ * \return false if this is not a report type we decode.
+ */
+constexpr bool
+classify( std::string_view ttaaii, WmoRaport &type )
+{
+	if( ttaaii.size() < 4 )
+		return false;
+
+	int t=detail::t1t2Table( ttaaii[0], ttaaii[1] );
+
+	if( t == detail::T1T2Table::BY_A1 ) {
+		//IS: surface data in BUFR.
+		if( ttaaii[2] == 'I' || ttaaii[2] == 'M' || ttaaii[2] == 'N' )
+			t=BUFR_SURFACE;
+		else if( ttaaii[2] == 'R' && ttaaii[3] == 'Z' )
+			t=TIDE;
+		else
+			t=detail::T1T2Table::UNKNOWN;
+	}
+
+	if( t < 0 )
+		return false;
+
+	type=static_cast<WmoRaport>( t );
+	return true;
+}
+
+/**
+ * Parse the GTS heading in \a line. The line must be on the form
+ * 'TTAAii CCCC YYGGgg [BBB]', where TTAAii is 6 letters or digits,
+ * with optional leading spaces and one or more spaces between the
+ * groups. This is what the regular expressions in the old dispatch
+ * accepted.
+ *
+ * \return false if \a line is not a GTS heading. header.known tells
+ *         if it is a report type we decode.
+ */
+bool parseGtsHeader( std::string_view line, GtsHeader &header );
+
+}
+
+#endif
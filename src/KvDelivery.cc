@@ -0,0 +1,612 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <errno.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sstream>
+#include <algorithm>
+#include <milog/milog.h>
+#include "KvDelivery.h"
+
+using namespace std;
+using kvalobs::datasource::Result;
+
+namespace {
+//The time before a message kvalobs did not save is resent.
+const std::chrono::milliseconds RETRY_DELAY(1000);
+
+/**
+ * Decide by the result from kvalobs if a message is sent, or if it
+ * should be resent. Only OK from kvalobs is accepted for a batch, the
+ * unknown stations in a batch is left to the sending of the reports
+ * one by one.
+ */
+bool
+checkResult(const Result &res, bool &tryToResend, bool batch)
+{
+	if(res.res==kvalobs::datasource::OK){
+		tryToResend=false;
+		return true;
+	}else if(res.res==kvalobs::datasource::NOTSAVED){
+		tryToResend=true;
+		LOGERROR("kvalobs NOTSAVED: " <<res.message);
+	}else if(res.res==kvalobs::datasource::ERROR){
+		LOGERROR("kvalobs ERROR: " << res.message);
+		tryToResend=true;
+	}else if(res.res==kvalobs::datasource::NODECODER){
+		LOGERROR("kvalobs NODECODER: " << res.message);
+		tryToResend=false;
+	}else  if(res.res==kvalobs::datasource::DECODEERROR){
+
+		string msg(res.message);
+		string::size_type i=msg.find("unknown station/position");
+
+		if( i == string::npos )
+			i = msg.find("Missing or unknown stationid!");
+
+		tryToResend=false;
+
+		//Dont log Unknown station/position. Treat it as a
+		//successfull transmit to kvalobs!
+		if(i!=string::npos && !batch)
+			return true;
+
+		LOGERROR("kvalobs DECODEERROR (rejected): " << res.message);
+	}else{
+		LOGERROR("kvalobs Unknown response from kvalobs. Check if the code is in sync"
+				<< " with 'datasource.idl'!");
+		tryToResend=false;
+	}
+
+	return false;
+}
+}
+
+KvDelivery::KvDelivery(DeliveryQueue &queue_, size_t server_, const std::string &name_,
+		const Conf &conf_, int timeoutMs)
+	:queue(queue_), server(server_), name(name_), conf(conf_),
+	 sender(name_, timeoutMs, conf_.connections, conf_.window),
+	 stopping(false), appended(false), next(0), answered(0), state(CLOSED), failures(0),
+	 cooldown(conf_.breakerCooldownMs), probing(false), probe(0),
+	 saveAt(std::chrono::steady_clock::time_point::max())
+{
+}
+
+KvDelivery::~KvDelivery()
+{
+	stop();
+}
+
+void
+KvDelivery::start()
+{
+	next=queue.cursor(server);
+	thread=std::thread(&KvDelivery::deliverLoop, this);
+}
+
+void
+KvDelivery::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping=true;
+	}
+
+	changed.notify_all();
+
+	//The delivery may wait for room in the window of the sender.
+	sender.stop();
+
+	if(!thread.joinable())
+		return;
+
+	thread.join();
+	sender.drain();
+}
+
+void
+KvDelivery::wakeUp()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	appended=true;
+	changed.notify_all();
+}
+
+void
+KvDelivery::deliverLoop()
+{
+	const size_t batchSize=conf.batchSize;
+	const std::chrono::milliseconds linger(conf.batchLingerMs);
+	std::vector<Record> batch;
+	std::vector<Record> records;
+	std::chrono::steady_clock::time_point lingerUntil;
+	std::chrono::steady_clock::time_point readAt; //When the new messages can be read.
+	std::unique_lock<std::mutex> lock(mutex);
+	unsigned long long readPos=next;
+	unsigned long long priorityPos=next; //The priority messages before it is sent.
+
+	while(!stopping){
+		std::chrono::steady_clock::time_point now=std::chrono::steady_clock::now();
+
+		//The cursor files is written and the segments removed without
+		//the lock, so the results is not held back.
+		if(saveAt<=now){
+			saveAt=std::chrono::steady_clock::time_point::max();
+			lock.unlock();
+			queue.saveCursors();
+			lock.lock();
+			continue;
+		}
+
+		//Give up the messages that has failed too many times. They is
+		//resent if they cant be saved.
+		if(!giveUp.empty()){
+			unsigned long long seq=giveUp.front();
+			Record rec;
+			string file;
+
+			giveUp.pop_front();
+			lock.unlock();
+
+			if(queue.read(seq, rec)==DeliveryQueue::READ_OK)
+				file=saveFailed(rec);
+
+			lock.lock();
+
+			if(file.empty()){
+				retries.push_back(std::make_pair(now+RETRY_DELAY, seq));
+				continue;
+			}
+
+			LOGERROR("kvserver " << name << ": Message " << seq << " is resent "
+					<< attempts[seq].tries << " times, it is given up. Saved: " << file);
+			outstanding[seq]=true;
+			attempts.erase(seq);
+			moveCursor();
+			continue;
+		}
+
+		if(state==OPEN){
+			if(now<openUntil){
+				changed.wait_until(lock, std::min(openUntil, saveAt));
+				continue;
+			}
+
+			LOGINFO("kvserver " << name << ": Sending one message to see if it is up again.");
+			state=HALF_OPEN;
+		}
+
+		//Only the probe is sent while the breaker is half open.
+		if(state==HALF_OPEN && probing){
+			if(saveAt==std::chrono::steady_clock::time_point::max())
+				changed.wait(lock);
+			else
+				changed.wait_until(lock, saveAt);
+
+			continue;
+		}
+
+		records.clear();
+
+		//The priority messages, ie. SPECI, is sent one by one ahead of
+		//the messages before them, and is skipped when they is read in
+		//their turn.
+		unsigned long long priority=std::max(priorityPos, readPos);
+
+		if(readAt<=now && queue.nextPriority(priority)){
+			records.emplace_back();
+			lock.unlock();
+
+			DeliveryQueue::ReadResult res=queue.read(priority, records.back());
+
+			lock.lock();
+
+			if(res!=DeliveryQueue::READ_OK){
+				LOGERROR("kvserver " << name << ": Cant read message " << priority
+						<< " from the queue. Will try again later!");
+				readAt=now+RETRY_DELAY;
+				continue;
+			}
+
+			priorityPos=priority+1;
+			outstanding[priority]=false;
+			setProbe(priority);
+
+			lock.unlock();
+			send(records);
+			lock.lock();
+			continue;
+		}
+
+		//Resend the messages kvalobs did not save, one by one, when
+		//they is due. A new message is preferred as the probe, so a
+		//message kvalobs will not save do not keep the breaker open.
+		std::deque<std::pair<std::chrono::steady_clock::time_point, unsigned long long>> *due=0;
+
+		if(!priorityRetries.empty() && priorityRetries.front().first<=now)
+			due=&priorityRetries;
+		else if(batch.empty() && !retries.empty() && retries.front().first<=now &&
+				(state!=HALF_OPEN || readPos>=queue.end() || readAt>now))
+			due=&retries;
+
+		if(due){
+			unsigned long long seq=due->front().second;
+
+			records.emplace_back();
+			due->pop_front();
+			lock.unlock();
+
+			if(queue.read(seq, records.back())!=DeliveryQueue::READ_OK){
+				lock.lock();
+				LOGERROR("kvserver " << name << ": Cant read message " << seq
+						<< " from the queue. Will try again later!");
+				due->push_back(std::make_pair(now+RETRY_DELAY, seq));
+				continue;
+			}
+
+			lock.lock();
+			setProbe(seq);
+			lock.unlock();
+			send(records);
+			lock.lock();
+			continue;
+		}
+
+		//Read the new messages. The messages to a batch decoder is
+		//collected in a batch until it is full, a message to another
+		//decoder is found or the first message has waited for linger.
+		bool full=false;
+		bool priorityFound=false;
+		appended=false;
+		lock.unlock();
+
+		for(unsigned long long end=queue.end(); readPos<end && readAt<=now; ){
+			Record rec;
+
+			if(!batch.empty() && (batch.size()>=batchSize ||
+					!conf.batchDecoder(batch.front().decoder))){
+				full=true;
+				break;
+			}
+
+			DeliveryQueue::ReadResult res=queue.read(readPos, rec);
+
+			//The messages lost from the log when it was opened is
+			//skipped, they is logged by the queue.
+			if(res==DeliveryQueue::READ_MISSING){
+				readPos++;
+				continue;
+			}
+
+			//The message is not skipped, it is read again later.
+			if(res!=DeliveryQueue::READ_OK){
+				LOGERROR("kvserver " << name << ": Cant read message " << readPos
+						<< " from the queue. Will try again later!");
+				readAt=now+RETRY_DELAY;
+				break;
+			}
+
+			//A priority message is never in a batch. It is sent by the
+			//next round if it is not sent yet.
+			if(rec.priority){
+				if(rec.seq<priorityPos){
+					readPos++;
+					continue;
+				}
+
+				priorityFound=true;
+				break;
+			}
+
+			//It is read again for the next batch.
+			if(!batch.empty() && rec.decoder!=batch.front().decoder){
+				full=true;
+				break;
+			}
+
+			if(batch.empty())
+				lingerUntil=now+linger;
+
+			batch.push_back(std::move(rec));
+			readPos++;
+		}
+
+		lock.lock();
+
+		if(stopping)
+			break;
+
+		//The messages before readPos is sent or skipped.
+		if(batch.empty() && next<readPos){
+			next=readPos;
+			moveCursor();
+		}
+
+		if(priorityFound)
+			continue;
+
+		if(batch.empty() || (!full && batch.size()<batchSize &&
+				conf.batchDecoder(batch.front().decoder) &&
+				state!=HALF_OPEN && now<lingerUntil)){
+			std::chrono::steady_clock::time_point wakeAt=
+					batch.empty()?std::chrono::steady_clock::time_point::max():lingerUntil;
+
+			if(!retries.empty() && retries.front().first<wakeAt)
+				wakeAt=retries.front().first;
+
+			if(!priorityRetries.empty() && priorityRetries.front().first<wakeAt)
+				wakeAt=priorityRetries.front().first;
+
+			if(saveAt<wakeAt)
+				wakeAt=saveAt;
+
+			if(readAt>now && readAt<wakeAt)
+				wakeAt=readAt;
+
+			if(!appended || readAt>now){
+				if(wakeAt==std::chrono::steady_clock::time_point::max())
+					changed.wait(lock);
+				else
+					changed.wait_until(lock, wakeAt);
+			}
+
+			continue;
+		}
+
+		//The probe is one message, the rest of the batch waits for
+		//the result of it.
+		if(state==HALF_OPEN){
+			setProbe(batch.front().seq);
+			records.push_back(std::move(batch.front()));
+			batch.erase(batch.begin());
+		}else{
+			records.swap(batch);
+		}
+
+		for(const Record &rec : records)
+			outstanding[rec.seq]=false;
+
+		next=records.back().seq+1;
+		lock.unlock();
+		send(records);
+		lock.lock();
+	}
+}
+
+void
+KvDelivery::send(const std::vector<Record> &records)
+{
+	std::vector<unsigned long long> seqs;
+	std::shared_ptr<std::string> msg=std::make_shared<std::string>();
+
+	if(records.size()==1){
+		*msg=records.front().msg;
+	}else{
+		for(const Record &rec : records){
+			*msg+=rec.msg;
+
+			if(!rec.msg.empty() && *rec.msg.rbegin()!='\n')
+				*msg+="\n";
+		}
+	}
+
+	for(const Record &rec : records)
+		seqs.push_back(rec.seq);
+
+	bool priority=records.size()==1 && records.front().priority;
+
+	//Waits while the window of messages in flight is full. When we
+	//stop the messages is not sent, they is left in the queue.
+	sender.sendAsync(*msg, records.front().decoder,
+			[this, seqs, priority, msg](const Result &res, const std::string &sentTo, bool failed){
+				result(seqs, priority, res, sentTo, failed, *msg);
+			});
+}
+
+void
+KvDelivery::result(const std::vector<unsigned long long> &seqs, bool priority,
+		const Result &res, const std::string &sentTo, bool sendFailed, const std::string &msg)
+{
+	bool batch=seqs.size()>1;
+	bool tryToResend;
+	bool ok;
+
+	LOGINFO("Sendt to servers: " << sentTo);
+	ok=checkResult(res, tryToResend, batch);
+
+	if(ok && batch)
+		LOGINFO("Sendt " << seqs.size() << " observations to kvalobs in one batch!");
+	else if(ok)
+		LOGINFO("Sendt observation to kvalobs!" << endl << msg);
+	else if(batch && !tryToResend)
+		LOGWARN("kvalobs did not accept the batch of " << seqs.size()
+				<< " observations. Sending them one by one.");
+	else if(tryToResend)
+		LOGERROR("Cant send observation to " << name << ". Will try to send later!" << endl << msg);
+	else
+		LOGERROR("Cant send observation to kvalobs." << endl << msg);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::chrono::steady_clock::time_point now=std::chrono::steady_clock::now();
+	bool isProbe=probing && seqs.size()==1 && seqs.front()==probe;
+
+	//The breaker is moved by the probe while it is half open. The
+	//messages sent before it is answered late, they does not close
+	//or open it again. A message kvalobs answered, also one it did not
+	//save, tells the kvserver is up.
+	if(isProbe)
+		probing=false;
+
+	if(isProbe || state==CLOSED){
+		if(sendFailed)
+			failed();
+		else
+			succeeded();
+	}
+
+	if(ok || !tryToResend){
+		//The result for each report in a batch decides if it is
+		//resent, they is sent one by one right away.
+		if(!ok && batch){
+			for(std::vector<unsigned long long>::const_reverse_iterator it=seqs.rbegin();
+					it!=seqs.rend(); ++it)
+				retries.push_front(std::make_pair(now, *it));
+		}else{
+			for(unsigned long long seq : seqs){
+				outstanding[seq]=true;
+				attempts.erase(seq);
+			}
+		}
+
+		answered++;
+	}else{
+		for(unsigned long long seq : seqs){
+			std::map<unsigned long long, Attempts>::iterator it=attempts.find(seq);
+
+			if(it==attempts.end()){
+				Attempts a={0, answered};
+				it=attempts.insert(std::make_pair(seq, a)).first;
+			}else if(it->second.answered!=answered){
+				it->second.tries++;
+				it->second.answered=answered;
+			}
+
+			if(it->second.tries>=conf.maxRetries)
+				giveUp.push_back(seq);
+			else
+				(priority?priorityRetries:retries).push_back(std::make_pair(now+RETRY_DELAY, seq));
+		}
+	}
+
+	moveCursor();
+	changed.notify_all();
+}
+
+void
+KvDelivery::setProbe(unsigned long long seq)
+{
+	if(state!=HALF_OPEN)
+		return;
+
+	probing=true;
+	probe=seq;
+}
+
+void
+KvDelivery::succeeded()
+{
+	failures=0;
+	cooldown=std::chrono::milliseconds(conf.breakerCooldownMs);
+
+	if(state!=CLOSED){
+		LOGINFO("kvserver " << name << " is up again, " << queue.end()-next
+				<< " messages is waiting for it.");
+		state=CLOSED;
+	}
+}
+
+void
+KvDelivery::failed()
+{
+	failures++;
+
+	if(state==OPEN || (state==CLOSED && failures<conf.breakerFailures))
+		return;
+
+	//A failed probe doubles the time before the next.
+	if(state==HALF_OPEN)
+		cooldown=std::min(2*cooldown, std::chrono::milliseconds(conf.breakerMaxCooldownMs));
+
+	LOGWARN("kvserver " << name << " failed " << failures << " times in a row. Stops sending to it for "
+			<< cooldown.count() << " ms.");
+	state=OPEN;
+	openUntil=std::chrono::steady_clock::now()+cooldown;
+}
+
+void
+KvDelivery::moveCursor()
+{
+	while(!outstanding.empty() && outstanding.begin()->second)
+		outstanding.erase(outstanding.begin());
+
+	//The priority messages is sent ahead of next.
+	saveAt=std::min(saveAt, queue.setCursor(server,
+			outstanding.empty()?next:std::min(next, outstanding.begin()->first)));
+}
+
+std::string
+KvDelivery::saveFailed(const Record &rec)
+{
+	ostringstream ost;
+	string        server(name);
+	string        content(rec.decoder+"\n"+rec.msg+"\n");
+
+	for(char &c : server){
+		if(!isalnum(static_cast<unsigned char>(c)) && c!='.' && c!='-')
+			c='_';
+	}
+
+	ost << conf.data2kvdir << "kvfailed_" << rec.decoder << "_" << server << "_" << rec.seq;
+
+	string      file(ost.str());
+	const char *p=content.data();
+	size_t      n=content.size();
+	int         fd=open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+
+	if(fd<0){
+		LOGERROR("Cant create <" << file << ">: " << strerror(errno));
+		return string();
+	}
+
+	while(n>0){
+		ssize_t ret=write(fd, p, n);
+
+		if(ret<0){
+			if(errno==EINTR)
+				continue;
+
+			break;
+		}
+
+		p+=ret;
+		n-=ret;
+	}
+
+	if(n>0 || fsync(fd)<0){
+		LOGERROR("Cant write <" << file << ">: " << strerror(errno));
+		close(fd);
+		unlink(file.c_str());
+		return string();
+	}
+
+	close(fd);
+	return file;
+}
@@ -0,0 +1,228 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __KvDelivery_h__
+#define __KvDelivery_h__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "DeliveryQueue.h"
+#include "KvSender.h"
+
+/**
+ * Deliver the messages in a DeliveryQueue to one kvserver.
+ *
+ * Each kvserver has its own KvDelivery, with its own cursor in the
+ * queue and its own connections, so a kvserver that is slow or down
+ * do not hold back the others. The messages is read from the cursor
+ * and sent with a window of messages in flight, the messages to a
+ * batch decoder is sent in batches. The cursor is moved past a
+ * message when kvalobs has answered it with a result that says it
+ * should not be resent. A message kvalobs did not save is resent
+ * later, a message is never dropped because the kvserver is down. A
+ * message that is resent maxRetries times, while kvalobs answers other
+ * messages, is given up and saved as a kvfailed_* file in data2kvdir.
+ *
+ * A priority message, ie. a SPECI, is never in a batch. It is sent, and
+ * resent, ahead of the messages that waits before it in the queue.
+ *
+ * A circuit breaker stops the sending when the kvserver fails
+ * breakerFailures times in a row, ie. the message could not be sent or
+ * timed out. An answer from kvalobs, also NOTSAVED or ERROR, is not a
+ * failure of the kvserver. The breaker is then open for
+ * breakerCooldownMs, after that one message is sent as a probe. If the
+ * probe succeeds the sending starts again, otherwise the breaker is
+ * open again, with the double time up to breakerMaxCooldownMs. Only
+ * the result of the probe moves the breaker out of half open, the
+ * results of the messages sent before it does not.
+ */
+class KvDelivery
+{
+	KvDelivery(const KvDelivery&);
+	KvDelivery& operator=(const KvDelivery&);
+
+public:
+	/**
+	 * The configuration of the delivery, it is set by App from
+	 * norcom2kv.conf. See App for the meaning of each.
+	 */
+	struct Conf {
+		std::set<std::string> batchDecoders;
+		int         batchSize;
+		int         batchLingerMs;
+		int         connections;
+		int         window;
+		int         breakerFailures;
+		int         breakerCooldownMs;
+		int         breakerMaxCooldownMs;
+		int         maxRetries;
+		std::string data2kvdir;
+
+		Conf(): batchSize(1), batchLingerMs(0), connections(1), window(1),
+		        breakerFailures(5), breakerCooldownMs(1000), breakerMaxCooldownMs(60000),
+		        maxRetries(20){}
+
+		/**
+		 * Shall the messages to \a decoder be sent in batches. \a decoder
+		 * may have a '/' and the decoder arguments after the name.
+		 */
+		bool batchDecoder(const std::string &decoder)const{
+			return !batchDecoders.empty() &&
+				batchDecoders.count(decoder.substr(0, decoder.find('/')))>0;
+		}
+	};
+
+private:
+	typedef enum { CLOSED, OPEN, HALF_OPEN } BreakerState;
+	typedef DeliveryQueue::Record Record;
+
+	DeliveryQueue &queue;
+	size_t         server;
+	std::string    name;
+	const Conf     conf;
+	KvSender       sender;
+	std::thread    thread;
+
+	//Protects all below. changed is notified when kvalobs answers,
+	//when a message is appended to the queue and when we stop.
+	std::mutex              mutex;
+	std::condition_variable changed;
+	bool                    stopping;
+	bool                    appended;
+
+	//The messages that is sent and the messages that is to be
+	//resent, true when a message is done. next is the first message
+	//in the queue that is not sent.
+	std::map<unsigned long long, bool> outstanding;
+	unsigned long long      next;
+
+	//The messages to resend, one by one, and when. The priority
+	//messages is resent ahead of the others.
+	std::deque<std::pair<std::chrono::steady_clock::time_point, unsigned long long>> retries;
+	std::deque<std::pair<std::chrono::steady_clock::time_point, unsigned long long>> priorityRetries;
+
+	//The number of times a resent message has failed, counted only
+	//when kvalobs has answered other messages since the last time, ie.
+	//when answered is changed. The messages is not given up because
+	//the kvserver is down.
+	struct Attempts {
+		int                tries;
+		unsigned long long answered;
+	};
+
+	std::map<unsigned long long, Attempts> attempts;
+	unsigned long long      answered;
+
+	//The messages that has failed maxRetries times, they is given up.
+	std::deque<unsigned long long> giveUp;
+
+	BreakerState              state;
+	int                       failures;
+	std::chrono::milliseconds cooldown;
+	std::chrono::steady_clock::time_point openUntil;
+	bool                      probing;
+	unsigned long long        probe; //The message sent as the probe.
+
+	//When the cursor that is moved should be saved. It is saved by
+	//deliverLoop without the lock, not by the threads of the sender.
+	std::chrono::steady_clock::time_point saveAt;
+
+	void deliverLoop();
+
+	/**
+	 * Send \a records in one message. It is called without the lock.
+	 */
+	void send(const std::vector<Record> &records);
+
+	/**
+	 * Handle the result from kvalobs for the messages \a seqs, sent in
+	 * the message \a msg. \a priority is true for a priority message,
+	 * it is sent alone. \a sendFailed is true if kvalobs did not
+	 * answer.
+	 */
+	void result(const std::vector<unsigned long long> &seqs, bool priority,
+	            const kvalobs::datasource::Result &res,
+	            const std::string &sentTo, bool sendFailed, const std::string &msg);
+
+	/**
+	 * Send \a seq as the probe if the breaker is half open.
+	 */
+	void setProbe(unsigned long long seq);
+
+	void succeeded();
+	void failed();
+
+	/**
+	 * Save \a rec in data2kvdir, on the form the messages is saved by
+	 * CollectWmoReports, but not as a kvdata_* file that is sent again.
+	 * It is called without the lock.
+	 *
+	 * \return The file, or an empty string if it cant be saved.
+	 */
+	std::string saveFailed(const Record &rec);
+
+	/**
+	 * Move the cursor past the messages that is done. The cursor is
+	 * saved later by deliverLoop.
+	 */
+	void moveCursor();
+
+public:
+	/**
+	 * \param server The index of the kvserver in the queue.
+	 * \param name The kvserver.
+	 * \param timeoutMs The timeout for the kvserver.
+	 */
+	KvDelivery(DeliveryQueue &queue, size_t server, const std::string &name,
+	           const Conf &conf, int timeoutMs);
+	~KvDelivery();
+
+	void start();
+
+	/**
+	 * Stop the delivery, after the messages in flight is answered or
+	 * has timed out. The messages that is not delivered is left in the
+	 * queue.
+	 */
+	void stop();
+
+	/**
+	 * Tell that there is new messages in the queue.
+	 */
+	void wakeUp();
+};
+
+#endif
@@ -0,0 +1,366 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <vector>
+#include <algorithm>
+#include <milog/milog.h>
+#include "kvsubscribe/HttpSendData.h"
+#include "KvSender.h"
+
+using namespace std;
+using kvalobs::datasource::Result;
+
+namespace {
+//The state of a message.
+const char PENDING=0;
+const char ANSWERED=1;
+const char TIMEOUT=2;
+}
+
+/**
+ * A message that is sent to the kvserver. It outlives the send if the
+ * kvserver times out. The result and the state is protected by
+ * KvSender::mutex.
+ */
+struct KvSender::Request
+{
+	std::string message;
+	std::string obsType;
+	Callback    callback;
+	std::chrono::steady_clock::time_point start;
+	Result      result;
+	char        state;
+	bool        failed; //The message could not be sent.
+
+	Request(const std::string &msg, const std::string &type, Callback cb)
+		:message(msg), obsType(type), callback(cb), state(PENDING), failed(false){
+	}
+};
+
+KvSender::KvSender(const std::string &kvserver, int timeoutMs, int connections_, int window_)
+	:name(kvserver), timeout(timeoutMs), window(std::max(window_, 1)),
+	 maxAbandoned(std::max(connections_, 1)), queue(window), occupied(0), stopping(false)
+{
+	for(int i=0; i<std::max(connections_, 1); i++)
+		startConnection();
+
+	timer=std::thread(&KvSender::timeoutLoop, this);
+}
+
+KvSender::~KvSender()
+{
+	std::list<std::shared_ptr<Connection>> toJoin;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping=true;
+
+		//A connection that is sending may hang for as long as the TCP
+		//stack lets it, it is abandoned. The others ends when the
+		//queue is closed.
+		for(std::shared_ptr<Connection> &conn : connections){
+			std::lock_guard<std::mutex> connLock(conn->mutex);
+
+			if(conn->sending){
+				conn->abandoned=true;
+				conn->thread.detach();
+			}else{
+				toJoin.push_back(conn);
+			}
+		}
+	}
+
+	queue.close();
+
+	for(std::shared_ptr<Connection> &conn : toJoin)
+		conn->thread.join();
+
+	changed.notify_all();
+	timer.join();
+}
+
+void
+KvSender::startConnection()
+{
+	std::shared_ptr<Connection> conn=std::make_shared<Connection>();
+
+	conn->thread=std::thread(&KvSender::sendLoop, this, conn);
+	connections.push_back(conn);
+}
+
+void
+KvSender::sendLoop(std::shared_ptr<Connection> conn)
+{
+	//One connection to the kvserver, it is kept open between the
+	//messages.
+	kvalobs::datasource::HttpSendData http(name);
+	std::shared_ptr<Request> req;
+
+	while(queue.pop(req)){
+		Result res;
+		bool   isDone=false;
+		bool   send=false;
+		bool   failed=false;
+
+		//A message that has timed out while it waited is not sent,
+		//the caller has got the result for it. When we stop, the
+		//messages that waits is failed.
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if(req->state==PENDING && stopping){
+				req->result.res=kvalobs::datasource::ERROR;
+				req->result.message="Not sent, the sending is stopped.";
+				isDone=done(req, ANSWERED);
+			}
+
+			if(req->state!=PENDING){
+				release();
+			}else{
+				std::lock_guard<std::mutex> connLock(conn->mutex);
+				conn->sending=true;
+				conn->since=std::chrono::steady_clock::now();
+				send=true;
+			}
+		}
+
+		if(!send){
+			if(isDone)
+				complete(*req);
+
+			req.reset();
+			continue;
+		}
+
+		try{
+			res=http.newData(req->message, req->obsType);
+		}
+		catch(const std::exception &ex){
+			res.res=kvalobs::datasource::ERROR;
+			res.message=ex.what();
+			failed=true;
+		}
+
+		{
+			std::lock_guard<std::mutex> connLock(conn->mutex);
+			conn->sending=false;
+
+			//The KvSender has given up the connection, it may be gone.
+			if(conn->abandoned){
+				conn->finished=true;
+				return;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if(req->state==PENDING){
+				req->result=res;
+				req->failed=failed;
+			}
+
+			isDone=done(req, ANSWERED);
+			release();
+		}
+
+		if(isDone)
+			complete(*req);
+
+		req.reset();
+	}
+}
+
+void
+KvSender::timeoutLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	std::vector<std::shared_ptr<Request>> expired;
+
+	while(!stopping || !inFlight.empty()){
+		std::chrono::steady_clock::time_point now=std::chrono::steady_clock::now();
+
+		//The requests is in inFlight in the order they was sent, so
+		//they time out in the same order.
+		while(!inFlight.empty() && inFlight.front()->start+timeout<=now){
+			std::shared_ptr<Request> req=inFlight.front();
+
+			done(req, TIMEOUT);
+			expired.push_back(req);
+		}
+
+		if(!expired.empty()){
+			lock.unlock();
+
+			for(std::shared_ptr<Request> &req : expired)
+				complete(*req);
+
+			expired.clear();
+			lock.lock();
+			continue;
+		}
+
+		std::chrono::steady_clock::time_point wakeAt=abandonStuck(now);
+
+		if(!inFlight.empty() && inFlight.front()->start+timeout<wakeAt)
+			wakeAt=inFlight.front()->start+timeout;
+
+		if(wakeAt==std::chrono::steady_clock::time_point::max())
+			changed.wait(lock);
+		else
+			changed.wait_until(lock, wakeAt);
+	}
+}
+
+std::chrono::steady_clock::time_point
+KvSender::abandonStuck(std::chrono::steady_clock::time_point now)
+{
+	std::chrono::steady_clock::time_point wakeAt=std::chrono::steady_clock::time_point::max();
+	std::list<std::shared_ptr<Connection>>::iterator it=connections.begin();
+	size_t stuck=0;
+
+	//The abandoned threads that has ended is forgotten.
+	abandoned.remove_if([](const std::shared_ptr<Connection> &conn){
+			std::lock_guard<std::mutex> connLock(conn->mutex);
+			return conn->finished;
+		});
+
+	while(it!=connections.end()){
+		std::shared_ptr<Connection> conn=*it;
+		std::lock_guard<std::mutex> connLock(conn->mutex);
+		std::chrono::steady_clock::time_point deadline=conn->since+2*timeout;
+
+		if(!conn->sending){
+			++it;
+			continue;
+		}
+
+		//Wait for an abandoned thread to end before the next is
+		//abandoned.
+		if(deadline>now || abandoned.size()>=maxAbandoned){
+			wakeAt=std::min(wakeAt, deadline>now?deadline:now+timeout);
+			++it;
+			continue;
+		}
+
+		conn->abandoned=true;
+		conn->thread.detach();
+		abandoned.push_back(conn);
+		it=connections.erase(it);
+		release();
+		stuck++;
+	}
+
+	if(stuck>0){
+		LOGWARN("kvserver " << name << ": " << stuck << " connections has not returned in "
+				<< 2*timeout.count() << " ms, they is abandoned.");
+	}
+
+	for(; stuck>0; stuck--)
+		startConnection();
+
+	return wakeAt;
+}
+
+bool
+KvSender::done(const std::shared_ptr<Request> &req, char state)
+{
+	if(req->state!=PENDING)
+		return false;
+
+	req->state=state;
+	inFlight.remove(req);
+	changed.notify_all();
+	return true;
+}
+
+void
+KvSender::release()
+{
+	--occupied;
+	changed.notify_all();
+}
+
+void
+KvSender::complete(Request &req)
+{
+	string sentTo(name);
+
+	//The state and the result is not changed after the request is
+	//done.
+	if(req.state==TIMEOUT){
+		req.result.res=kvalobs::datasource::ERROR;
+		req.result.message="Timeout.";
+		sentTo+=" (TIMEOUT)";
+		req.failed=true;
+	}else if(req.failed){
+		sentTo+=" (FAILED)";
+	}
+
+	req.callback(req.result, sentTo, req.failed);
+}
+
+bool
+KvSender::sendAsync(const std::string &message, const std::string &obsType,
+		Callback callback)
+{
+	std::shared_ptr<Request> req=std::make_shared<Request>(message, obsType, callback);
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this](){ return occupied<window || stopping; });
+
+		if(stopping)
+			return false;
+
+		req->start=std::chrono::steady_clock::now();
+		inFlight.push_back(req);
+		++occupied;
+	}
+
+	//Let the timer see the new deadline. The queue has room for the
+	//window, so it does not wait.
+	changed.notify_all();
+	queue.push(req);
+	return true;
+}
+
+void
+KvSender::stop()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	stopping=true;
+	changed.notify_all();
+}
+
+void
+KvSender::drain()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this](){ return inFlight.empty(); });
+}
@@ -0,0 +1,178 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __KvSender_h__
+#define __KvSender_h__
+
+#include <string>
+#include <list>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "kvsubscribe/SendData.h"
+#include "BoundedQueue.h"
+
+/**
+ * Send the messages to a kvserver over a pool of connections.
+ *
+ * Each connection has its own http client and thread, and is kept
+ * open between the messages. Up to \a window messages is in flight at
+ * once. When the kvserver has answered a message, or the timeout has
+ * expired, the result is given to the callback for the message. A
+ * message that times out is counted as failed. It is not sent if it
+ * still waits for a connection, and it holds its place in the window
+ * until the connections is done with it.
+ *
+ * HttpSendData has no timeout of its own, so a connection that is
+ * still sending a message twice the timeout after it was sent, ie. to
+ * a kvserver that do not answer, is abandoned. Its place in the window
+ * is freed and a new connection takes over. The abandoned thread ends
+ * when the send returns, without touching the KvSender. There is at
+ * most \a connections abandoned threads at once.
+ */
+class KvSender
+{
+	KvSender(const KvSender&);
+	KvSender& operator=(const KvSender&);
+
+public:
+	/**
+	 * Called when a message is done, from one of the threads of the
+	 * KvSender. \a sentTo is the kvserver, with ' (FAILED)' or
+	 * ' (TIMEOUT)' after it if it failed. \a failed is true if the
+	 * message could not be sent or timed out, ie. kvalobs has not
+	 * answered it.
+	 */
+	typedef std::function<void(const kvalobs::datasource::Result &result,
+	                           const std::string &sentTo, bool failed)> Callback;
+
+private:
+	struct Request;
+
+	/**
+	 * A connection and its thread. It is shared with the thread, so
+	 * the thread can find out that it is abandoned after the KvSender
+	 * is gone. Protected by its own mutex, it is locked after
+	 * KvSender::mutex.
+	 */
+	struct Connection {
+		std::mutex  mutex;
+		std::thread thread;
+		bool        sending;   //In HttpSendData::newData.
+		bool        abandoned; //The thread must not touch the KvSender.
+		bool        finished;  //The thread has ended.
+		std::chrono::steady_clock::time_point since; //The send started.
+
+		Connection(): sending(false), abandoned(false), finished(false){}
+	};
+
+	std::string               name;
+	std::chrono::milliseconds timeout;
+	size_t                    window;
+	size_t                    maxAbandoned;
+	BoundedQueue<std::shared_ptr<Request>> queue;
+
+	//The requests in flight, protected by mutex. changed is notified
+	//when a request is done, released or added. occupied is the
+	//requests that the connections is not done with, also the
+	//requests that has timed out. It is limited by window.
+	std::mutex              mutex;
+	std::condition_variable changed;
+	std::list<std::shared_ptr<Request>> inFlight;
+	size_t                  occupied;
+	bool                    stopping;
+	std::list<std::shared_ptr<Connection>> connections;
+	std::list<std::shared_ptr<Connection>> abandoned;
+	std::thread             timer;
+
+	void sendLoop(std::shared_ptr<Connection> conn);
+	void timeoutLoop();
+	void startConnection();
+
+	/**
+	 * Abandon the connections that has been sending for twice the
+	 * timeout at \a now, and start new ones in their place.
+	 *
+	 * \return When the next connection is to be abandoned, if it is
+	 *         still sending, or time_point::max().
+	 */
+	std::chrono::steady_clock::time_point abandonStuck(std::chrono::steady_clock::time_point now);
+
+	/**
+	 * Give \a req the result \a state, and remove it from inFlight.
+	 *
+	 * \return false if it already has a result. Otherwise the callback
+	 *         must be called by the caller without the lock.
+	 */
+	bool done(const std::shared_ptr<Request> &req, char state);
+	void complete(Request &req);
+
+	/**
+	 * The connections is done with \a req, the window is free for a
+	 * new request.
+	 */
+	void release();
+
+public:
+	/**
+	 * \param kvserver The kvserver to send to.
+	 * \param timeoutMs The timeout, in milliseconds.
+	 * \param connections The number of connections to the kvserver.
+	 * \param window The max number of messages in flight.
+	 */
+	KvSender(const std::string &kvserver, int timeoutMs, int connections, int window);
+	~KvSender();
+
+	/**
+	 * Send \a message to the kvserver, \a callback is called when it
+	 * is done. Waits while there is \a window messages in flight, it
+	 * must not be called from a callback.
+	 *
+	 * \return false if the KvSender is stopped, the message is not
+	 *         sent and the callback is not called.
+	 */
+	bool sendAsync(const std::string &message, const std::string &obsType,
+	               Callback callback);
+
+	/**
+	 * Stop sending. A sendAsync that waits returns, and the messages
+	 * that waits for a connection is failed. The messages that is sent
+	 * is answered or times out as before.
+	 */
+	void stop();
+
+	/**
+	 * Wait until all the messages in flight is done.
+	 */
+	void drain();
+};
+
+#endif
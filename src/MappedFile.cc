@@ -0,0 +1,142 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "MappedFile.h"
+
+MappedFile::MappedFile()
+	:addr_(0), size_(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool
+MappedFile::open(const std::string &name)
+{
+	struct stat sbuf;
+	void *addr;
+	int  fd;
+	int  err;
+
+	close();
+
+	fd=::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if(fd<0)
+		return false;
+
+	if(fstat(fd, &sbuf)<0){
+		err=errno;
+		::close(fd);
+		errno=err;
+		return false;
+	}
+
+	//mmap does not accept a zero length, an empty file is an
+	//empty view.
+	if(sbuf.st_size==0){
+		::close(fd);
+		return true;
+	}
+
+	addr=mmap(0, sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	err=errno;
+	::close(fd);
+
+	if(addr==MAP_FAILED){
+		errno=err;
+		return false;
+	}
+
+	madvise(addr, sbuf.st_size, MADV_SEQUENTIAL);
+
+	addr_=addr;
+	size_=sbuf.st_size;
+	return true;
+}
+
+bool
+MappedFile::load(const std::string &name, size_t length)
+{
+	size_t  nRead=0;
+	ssize_t n;
+	int     fd;
+	int     err=0;
+
+	close();
+
+	fd=::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if(fd<0)
+		return false;
+
+	buf_.resize(length);
+
+	while(nRead<length){
+		n=pread(fd, &buf_[nRead], length-nRead, nRead);
+
+		if(n<0 && errno==EINTR)
+			continue;
+
+		if(n<=0){
+			err=n<0?errno:EIO;
+			break;
+		}
+
+		nRead+=n;
+	}
+
+	::close(fd);
+
+	if(nRead<length){
+		buf_.clear();
+		errno=err;
+		return false;
+	}
+
+	return true;
+}
+
+void
+MappedFile::close()
+{
+	if(addr_)
+		munmap(addr_, size_);
+
+	addr_=0;
+	size_=0;
+	buf_.clear();
+}
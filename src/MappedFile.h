@@ -0,0 +1,81 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __MappedFile_h__
+#define __MappedFile_h__
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+
+/**
+ * A read only memory map of a file.
+ *
+ * The file must not be truncated while it is mapped, so only map
+ * files we own, ie. the copies in tmpdir.
+ */
+class MappedFile
+{
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	void   *addr_;
+	size_t size_;
+	std::string buf_;
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	/**
+	 * Map the file \a name. Any previous mapping is unmapped.
+	 *
+	 * \return false if the file can't be opened or mapped. errno is set.
+	 */
+	bool open(const std::string &name);
+
+	/**
+	 * Read the first \a length bytes of the file \a name into memory
+	 * instead of mapping it. Use this for files that may be truncated
+	 * by others while we use it.
+	 *
+	 * \return false if the file can't be opened or has less than
+	 *         \a length bytes.
+	 */
+	bool load(const std::string &name, size_t length);
+	void close();
+
+	size_t size()const{ return addr_?size_:buf_.size();}
+	std::string_view view()const{
+		if(addr_)
+			return std::string_view(static_cast<const char*>(addr_), size_);
+		return buf_;
+	}
+};
+
+#endif
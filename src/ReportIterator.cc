@@ -0,0 +1,205 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <ctype.h>
+#include <string.h>
+#include "ReportIterator.h"
+#include "ScanKernels.h"
+
+namespace {
+
+//As isspace in the C locale, what boost::trim_right use.
+inline bool
+isSpace( char ch )
+{
+	return ch == ' ' || ( ch >= '\t' && ch <= '\r' );
+}
+
+std::string_view
+trimRight( std::string_view s )
+{
+	size_t n=s.size();
+
+	while( n > 0 && isSpace( s[n-1] ) )
+		--n;
+
+	return s.substr( 0, n );
+}
+
+}
+
+namespace wmoraport {
+
+//The reading is done as with an istream, eof_ is set when we try to
+//read past the end and then all the reads after that fails.
+bool
+ReportIterator::
+getline( std::string_view &line )
+{
+	if( eof_ )
+		return false;
+
+	if( pos_ >= buf_.size() ) {
+		eof_=true;
+		return false;
+	}
+
+	size_t b=pos_;
+	const char *nl=static_cast<const char*>(
+			memchr( buf_.data() + b, '\n', buf_.size() - b ) );
+
+	if( nl ) {
+		pos_=nl - buf_.data();
+		line=buf_.substr( b, pos_ - b );
+		++pos_;
+	} else {
+		pos_=buf_.size();
+		line=buf_.substr( b );
+		eof_=true;
+	}
+
+	return true;
+}
+
+void
+ReportIterator::
+skip( bool withSpace )
+{
+	if( eof_ )
+		return;
+
+	pos_+=spanLineBreaks( buf_.data() + pos_, buf_.size() - pos_, withSpace );
+
+	if( pos_ >= buf_.size() )
+		eof_=true;
+}
+
+std::string_view
+ReportIterator::
+readLine( char &extra )
+{
+	size_t b;
+	size_t n;
+
+	extra='\0';
+	skip( true );
+
+	if( eof_ )
+		return std::string_view();
+
+	b=pos_;
+	n=spanLineChars( buf_.data() + b, buf_.size() - b );
+	pos_=b + n;
+
+	if( pos_ >= buf_.size() ) {
+		//The istream code got the last character once more
+		//when the line ended at the end of the bulletin.
+		eof_=true;
+		extra=buf_[pos_ - 1];
+	} else {
+		//Skip the character that ended the line.
+		++pos_;
+		skip( false );
+	}
+
+	return buf_.substr( b, n );
+}
+
+std::string_view
+ReportIterator::
+line()
+{
+	char extra;
+	std::string_view l=readLine( extra );
+
+	if( extra == '\0' )
+		return l;
+
+	line_.assign( l );
+	line_+=extra;
+	return line_;
+}
+
+bool
+ReportIterator::
+next( std::string_view &report )
+{
+	char extra;
+	size_t i;
+	std::string_view l=readLine( extra );
+
+	report_.clear();
+
+	if( l.empty() )
+		return false;
+
+	report_.append( l );
+
+	if( extra != '\0' )
+		report_+=extra;
+
+	report_.erase( trimRight( report_ ).size() );
+	i=report_.find( '=' );
+
+	if( i != std::string::npos ) {
+		//Clean eventually rubbish from the end.
+		report_.erase( i + 1 );
+		report_+='\n';
+		report=report_;
+		return true;
+	}
+
+	report_+='\n';
+
+	while( getline( l ) ) {
+		l=trimRight( l );
+		i=l.find( '=' );
+
+		if( i != std::string_view::npos ) {
+			report_.append( l.substr( 0, i + 1 ) );
+			report_+='\n';
+			report=report_;
+			return true;
+		}
+
+		report_.append( l );
+		report_+='\n';
+	}
+
+	for( char ch : report_ ) {
+		if( ! isSpace( ch ) ) {
+			report_+='\n';
+			report=report_;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+}
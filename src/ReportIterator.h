@@ -0,0 +1,104 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __ReportIterator_h__
+#define __ReportIterator_h__
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+
+namespace wmoraport {
+
+/**
+ * Iterate over the '='-terminated reports in the text of a bulletin.
+ *
+ * The reports is split as the old istream based WMORaport::readReport
+ * and WMORaport::skipEmptyLines did, also in malformed input. Each line
+ * in a report is right trimmed, '\\r' and the rest of the line after
+ * the '=' is removed, and the lines is joined with '\\n'.
+ *
+ * The bulletin is not copied. A report is built in a buffer that is
+ * reused for all the reports in the bulletin, so there is no
+ * allocations for each report. The views returned is valid until the
+ * next call to next().
+ */
+class ReportIterator
+{
+	std::string_view buf_;
+	size_t           pos_;
+	bool             eof_;
+	std::string      report_;
+	std::string      line_;
+
+	bool getline( std::string_view &line );
+
+	/**
+	 * Skip '\\t', '\\r' and '\\n', and ' ' if \a withSpace is true.
+	 */
+	void skip( bool withSpace );
+
+	/**
+	 * Skip empty lines and read the first line, only letters, digits
+	 * and ' /=' is read.
+	 *
+	 * \param[out] extra Is set to a repeated last character, if there
+	 *             is one, else to '\\0'.
+	 */
+	std::string_view readLine( char &extra );
+
+public:
+	explicit ReportIterator( std::string_view buf )
+		: buf_( buf ), pos_( 0 ), eof_( false ) {}
+
+	/**
+	 * Skip empty lines and get the next line, ie. the GTS heading of
+	 * the bulletin.
+	 *
+	 * \return An empty view when there is no more lines.
+	 */
+	std::string_view line();
+
+	/**
+	 * Get the next report.
+	 *
+	 * \return false when there is no more reports.
+	 */
+	bool next( std::string_view &report );
+
+	/**
+	 * The rest of the bulletin, ie. the binary data of a BUFR bulletin.
+	 */
+	std::string_view rest()const {
+		return eof_ ? std::string_view() : buf_.substr( pos_ );
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,267 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include "ScanKernels.h"
+
+#if defined( __x86_64__ ) || ( defined( __i386__ ) && defined( __SSE2__ ) )
+#define SCAN_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline bool
+isLineChar( unsigned char ch )
+{
+	return ( ch >= '0' && ch <= '9' ) || ( ch >= 'A' && ch <= 'Z' ) ||
+			( ch >= 'a' && ch <= 'z' ) || ch == ' ' || ch == '/' || ch == '=';
+}
+
+inline bool
+isLineBreak( unsigned char ch, bool withSpace )
+{
+	return ch == '\t' || ch == '\r' || ch == '\n' || ( withSpace && ch == ' ' );
+}
+
+size_t
+spanLineCharsScalar( const char *p, size_t n )
+{
+	size_t i=0;
+
+	while( i < n && isLineChar( p[i] ) )
+		++i;
+
+	return i;
+}
+
+size_t
+spanLineBreaksScalar( const char *p, size_t n, bool withSpace )
+{
+	size_t i=0;
+
+	while( i < n && isLineBreak( p[i], withSpace ) )
+		++i;
+
+	return i;
+}
+
+#ifdef SCAN_KERNELS_X86
+
+//The byte ranges is tested unsigned as min(x-lo, hi-lo) == x-lo, there
+//is no unsigned compare of bytes. The letters is tested in lower case,
+//x|0x20 is in 'a'..'z' only for the letters.
+
+inline __m128i
+inRange( __m128i x, char lo, char hi )
+{
+	__m128i d=_mm_sub_epi8( x, _mm_set1_epi8( lo ) );
+	return _mm_cmpeq_epi8( _mm_min_epu8( d, _mm_set1_epi8( hi - lo ) ), d );
+}
+
+inline unsigned
+lineCharMask( __m128i x )
+{
+	__m128i m=_mm_or_si128( inRange( x, '/', '9' ),
+			inRange( _mm_or_si128( x, _mm_set1_epi8( 0x20 ) ), 'a', 'z' ) );
+	m=_mm_or_si128( m, _mm_cmpeq_epi8( x, _mm_set1_epi8( ' ' ) ) );
+	m=_mm_or_si128( m, _mm_cmpeq_epi8( x, _mm_set1_epi8( '=' ) ) );
+	return _mm_movemask_epi8( m );
+}
+
+inline unsigned
+lineBreakMask( __m128i x, __m128i space )
+{
+	__m128i m=_mm_or_si128( _mm_cmpeq_epi8( x, _mm_set1_epi8( '\t' ) ),
+			_mm_cmpeq_epi8( x, _mm_set1_epi8( '\r' ) ) );
+	m=_mm_or_si128( m, _mm_cmpeq_epi8( x, _mm_set1_epi8( '\n' ) ) );
+	m=_mm_or_si128( m, _mm_cmpeq_epi8( x, space ) );
+	return _mm_movemask_epi8( m );
+}
+
+size_t
+spanLineCharsSSE2( const char *p, size_t n )
+{
+	size_t i=0;
+
+	for( ; i + 16 <= n; i+=16 ) {
+		unsigned m=~lineCharMask(
+				_mm_loadu_si128( reinterpret_cast<const __m128i*>( p + i ) ) ) & 0xFFFF;
+
+		if( m )
+			return i + __builtin_ctz( m );
+	}
+
+	return i + spanLineCharsScalar( p + i, n - i );
+}
+
+size_t
+spanLineBreaksSSE2( const char *p, size_t n, bool withSpace )
+{
+	//'\n' is in the set, so it can be used in place of ' '.
+	__m128i space=_mm_set1_epi8( withSpace ? ' ' : '\n' );
+	size_t i=0;
+
+	for( ; i + 16 <= n; i+=16 ) {
+		unsigned m=~lineBreakMask(
+				_mm_loadu_si128( reinterpret_cast<const __m128i*>( p + i ) ), space ) & 0xFFFF;
+
+		if( m )
+			return i + __builtin_ctz( m );
+	}
+
+	return i + spanLineBreaksScalar( p + i, n - i, withSpace );
+}
+
+__attribute__(( target( "avx2" ) )) inline __m256i
+inRange256( __m256i x, char lo, char hi )
+{
+	__m256i d=_mm256_sub_epi8( x, _mm256_set1_epi8( lo ) );
+	return _mm256_cmpeq_epi8( _mm256_min_epu8( d, _mm256_set1_epi8( hi - lo ) ), d );
+}
+
+__attribute__(( target( "avx2" ) )) size_t
+spanLineCharsAVX2( const char *p, size_t n )
+{
+	size_t i=0;
+
+	for( ; i + 32 <= n; i+=32 ) {
+		__m256i x=_mm256_loadu_si256( reinterpret_cast<const __m256i*>( p + i ) );
+		__m256i m=_mm256_or_si256( inRange256( x, '/', '9' ),
+				inRange256( _mm256_or_si256( x, _mm256_set1_epi8( 0x20 ) ), 'a', 'z' ) );
+		m=_mm256_or_si256( m, _mm256_cmpeq_epi8( x, _mm256_set1_epi8( ' ' ) ) );
+		m=_mm256_or_si256( m, _mm256_cmpeq_epi8( x, _mm256_set1_epi8( '=' ) ) );
+		unsigned r=~static_cast<unsigned>( _mm256_movemask_epi8( m ) );
+
+		if( r )
+			return i + __builtin_ctz( r );
+	}
+
+	return i + spanLineCharsSSE2( p + i, n - i );
+}
+
+__attribute__(( target( "avx2" ) )) size_t
+spanLineBreaksAVX2( const char *p, size_t n, bool withSpace )
+{
+	__m256i space=_mm256_set1_epi8( withSpace ? ' ' : '\n' );
+	size_t i=0;
+
+	for( ; i + 32 <= n; i+=32 ) {
+		__m256i x=_mm256_loadu_si256( reinterpret_cast<const __m256i*>( p + i ) );
+		__m256i m=_mm256_or_si256( _mm256_cmpeq_epi8( x, _mm256_set1_epi8( '\t' ) ),
+				_mm256_cmpeq_epi8( x, _mm256_set1_epi8( '\r' ) ) );
+		m=_mm256_or_si256( m, _mm256_cmpeq_epi8( x, _mm256_set1_epi8( '\n' ) ) );
+		m=_mm256_or_si256( m, _mm256_cmpeq_epi8( x, space ) );
+		unsigned r=~static_cast<unsigned>( _mm256_movemask_epi8( m ) );
+
+		if( r )
+			return i + __builtin_ctz( r );
+	}
+
+	return i + spanLineBreaksSSE2( p + i, n - i, withSpace );
+}
+
+#endif
+
+struct Kernels {
+	const char *name;
+	size_t ( *spanLineChars )( const char *p, size_t n );
+	size_t ( *spanLineBreaks )( const char *p, size_t n, bool withSpace );
+};
+
+const Kernels scalarKernels={ "scalar", spanLineCharsScalar, spanLineBreaksScalar };
+#ifdef SCAN_KERNELS_X86
+const Kernels sse2Kernels={ "sse2", spanLineCharsSSE2, spanLineBreaksSSE2 };
+const Kernels avx2Kernels={ "avx2", spanLineCharsAVX2, spanLineBreaksAVX2 };
+#endif
+
+//Is constant initialized, so the scalar kernels is used if a kernel is
+//called before the kernels is chosen.
+const Kernels *kernels=&scalarKernels;
+
+const Kernels *
+findKernels( const char *name )
+{
+	if( ! name || strcmp( name, "scalar" ) == 0 )
+		return &scalarKernels;
+
+#ifdef SCAN_KERNELS_X86
+	if( strcmp( name, "sse2" ) == 0 )
+		return &sse2Kernels;
+
+	if( strcmp( name, "avx2" ) == 0 ) {
+		__builtin_cpu_init();
+
+		if( __builtin_cpu_supports( "avx2" ) )
+			return &avx2Kernels;
+	}
+#endif
+
+	return 0;
+}
+
+//The lines in the bulletins is short, most of them is scanned in one
+//or two 16 byte blocks, so SSE2 is as fast as AVX2 or faster. AVX2
+//is only used when it is asked for.
+const bool kernelsChosen=wmoraport::useScanKernels( "sse2" );
+
+}
+
+namespace wmoraport {
+
+size_t
+spanLineChars( const char *p, size_t n )
+{
+	return kernels->spanLineChars( p, n );
+}
+
+size_t
+spanLineBreaks( const char *p, size_t n, bool withSpace )
+{
+	return kernels->spanLineBreaks( p, n, withSpace );
+}
+
+const char *
+scanKernels()
+{
+	return kernels->name;
+}
+
+bool
+useScanKernels( const char *name )
+{
+	const Kernels *k=findKernels( name );
+
+	if( ! k )
+		return false;
+
+	kernels=k;
+	return true;
+}
+
+}
@@ -0,0 +1,74 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __ScanKernels_h__
+#define __ScanKernels_h__
+
+#include <stddef.h>
+
+namespace wmoraport {
+
+/**
+ * Scanning of the character classes in the text of a bulletin, 16 or
+ * 32 bytes at a time.
+ *
+ * There is a SSE2, an AVX2 and a scalar version of each kernel. The
+ * SSE2 version is used if the CPU supports it, on the short lines of
+ * the bulletins it is faster than the AVX2 version. The results is the
+ * same for all of them. The characters is classified as in the C
+ * locale.
+ */
+
+/**
+ * The length of the run of letters, digits, ' ', '/' and '=' at
+ * the start of [p, p+n), ie. the characters in a line of a report.
+ */
+size_t spanLineChars( const char *p, size_t n );
+
+/**
+ * The length of the run of '\\t', '\\r' and '\\n' at the start of
+ * [p, p+n). ' ' is also in the run if \a withSpace is true.
+ */
+size_t spanLineBreaks( const char *p, size_t n, bool withSpace );
+
+/**
+ * The name of the kernels in use, "avx2", "sse2" or "scalar".
+ */
+const char *scanKernels();
+
+/**
+ * Use the kernels \a name, "avx2", "sse2" or "scalar", instead of
+ * the ones chosen at startup. Used to compare them.
+ *
+ * \return false if the CPU do not support them.
+ */
+bool useScanKernels( const char *name );
+
+}
+
+#endif
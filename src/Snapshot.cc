@@ -0,0 +1,152 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <fileutil/copyfile.h>
+#include "Snapshot.h"
+
+namespace snapshot {
+
+namespace {
+
+bool
+copyRange( int in, int out, off_t size )
+{
+	loff_t inOffset=0;
+	loff_t outOffset=0;
+	ssize_t n;
+
+	while( inOffset < size ) {
+		n=copy_file_range( in, &inOffset, out, &outOffset, size-inOffset, 0 );
+
+		if( n < 0 ) {
+			if( errno == EINTR )
+				continue;
+			return false;
+		}
+
+		if( n == 0 ) //The file is truncated under us.
+			return false;
+	}
+
+	return true;
+}
+
+}
+
+std::string
+methodToString( Method method )
+{
+	switch( method ) {
+	case REFLINK:    return "reflink";
+	case HARDLINK:   return "hardlink";
+	case COPY_RANGE: return "copy_file_range";
+	case COPY:       return "copy";
+	default:
+		return "failed";
+	}
+}
+
+Method
+takeSnapshot( const std::string &from, const std::string &to,
+              bool appendOnly, off_t &size )
+{
+	struct stat sbuf;
+	Method method=FAILED;
+	int in;
+	int out;
+
+	size=0;
+	in=open( from.c_str(), O_RDONLY | O_CLOEXEC );
+
+	if( in < 0 )
+		return FAILED;
+
+	if( fstat( in, &sbuf ) < 0 ) {
+		close( in );
+		return FAILED;
+	}
+
+	size=sbuf.st_size;
+	unlink( to.c_str() );
+	out=open( to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644 );
+
+	if( out < 0 ) {
+		close( in );
+		return FAILED;
+	}
+
+	if( ioctl( out, FICLONE, in ) == 0 ) {
+		method=REFLINK;
+	} else if( appendOnly ) {
+		close( out );
+		out=-1;
+		unlink( to.c_str() );
+
+		if( link( from.c_str(), to.c_str() ) == 0 ) {
+			method=HARDLINK;
+		} else {
+			out=open( to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644 );
+
+			if( out < 0 ) {
+				close( in );
+				return FAILED;
+			}
+		}
+	}
+
+	if( method == FAILED && copyRange( in, out, size ) )
+		method=COPY_RANGE;
+
+	if( out >= 0 )
+		close( out );
+
+	close( in );
+
+	if( method == FAILED ) {
+		unlink( to.c_str() );
+
+		if( miutil::file::copyfile( from, to ) ) {
+			struct stat sbuf;
+
+			if( stat( to.c_str(), &sbuf ) == 0 ) {
+				size=sbuf.st_size;
+				method=COPY;
+			}
+		}
+	}
+
+	return method;
+}
+
+}
@@ -0,0 +1,66 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __Snapshot_h__
+#define __Snapshot_h__
+
+#include <sys/types.h>
+#include <string>
+
+namespace snapshot {
+
+typedef enum { FAILED, REFLINK, HARDLINK, COPY_RANGE, COPY } Method;
+
+std::string methodToString( Method method );
+
+/**
+ * Take a snapshot of the file \a from in the file \a to. The cheapest
+ * method the filesystem supports is used, in this order:
+ *
+ *   - REFLINK: a copy-on-write clone of the file (FICLONE).
+ *   - HARDLINK: only when \a appendOnly is true. The snapshot shares
+ *     the data with \a from, so only the first \a size bytes of it
+ *     is a valid snapshot.
+ *   - COPY_RANGE: an in kernel copy with copy_file_range.
+ *   - COPY: a plain userspace copy.
+ *
+ * REFLINK and HARDLINK requires that \a from and \a to is on the same
+ * filesystem.
+ *
+ * \param from The file to take a snapshot of.
+ * \param to The name of the snapshot.
+ * \param appendOnly true if we know the file is only appended to.
+ * \param[out] size The size of \a from when the snapshot was taken.
+ * \return The method used, or FAILED if no snapshot could be taken.
+ */
+Method takeSnapshot( const std::string &from, const std::string &to,
+                     bool appendOnly, off_t &size );
+
+}
+
+#endif
@@ -34,13 +34,14 @@
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
-#include <boost/regex.hpp>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
 #include <stdexcept>
-#include <miutil/base64.h>
-#include <miutil/trimstr.h>
 #include "WMORaport.h"
+#include "BulletinFramer.h"
+#include "GtsHeader.h"
+#include "ReportIterator.h"
+#include "Base64.h"
 
 using namespace std;
 using namespace boost;
@@ -60,131 +61,280 @@ using namespace boost;
  *    SS                   -> drau
  *    SO                   -> bath
  *    ISRZ                 -> tide
+ *    ISI,ISM,ISN          -> bufr surface
+ *
+ * The message type is found by wmoraport::classify, see GtsHeader.h.
  */
 
 
 namespace{
 
-regex zczc("^ *ZCZC *[0-9]*\\r+");
-regex synopType("(^ *((AA|BB|OO)XX *(\\d{4}.)? *(\\w+)?))?(.*)");
-regex synopIsNil("^\\s*(\\d+)? *NIL *=?\\s*");
-regex metarType("(^ *(METAR|SPECI))?(.*)");
-//regex metarType("^ *(METAR|SPECI) *");
-regex synop("^ *S(I|M|N)\\w{4} +\\w+ +\\d+ *\\w*");
-regex metar("^ *S(A|P)\\w{4} +\\w+ +\\d+ *\\w*");
-regex temp("^ *U(E|F|K|L|M|S|Z)\\w{4} +\\w+ +\\d+ *\\w*");
-regex pilo("^ *U(G|H|I|P|Q|Y)\\w{4} +\\w+ +\\d+ *\\w*");
-regex arep("^ *U(A|D)\\w{4} +\\w+ +\\d+ *\\w*");
-regex drau("^ *SS\\w{4} +\\w+ +\\d+ *\\w*");
-regex bath("^ *SO\\w{4} +\\w+ +\\d+ *\\w*");
-regex tide("^ *ISRZ\\w{2}+ +\\w+ +\\d+ *\\w*");
-regex bufrSurface("^ *IS(I|M|N)\\w{3} +\\w+ +\\d+ *\\w*");
+//As isspace in the C locale, what boost::trim use.
+inline bool
+isSpaceChar( char ch )
+{
+	return ch == ' ' || ( ch >= '\t' && ch <= '\r' );
+}
 
-bool
-validChar( char ch, const char *valid )
+inline bool
+isDigitChar( char ch )
+{
+	return ch >= '0' && ch <= '9';
+}
+
+//As \w in the regular expressions.
+inline bool
+isWordChar( char ch )
 {
-	int i;
-	for( i=0; valid[i] && valid[i]!=ch; ++i );
-	return valid[i];
+	return isDigitChar( ch ) || ( ch >= 'a' && ch <= 'z' ) ||
+			( ch >= 'A' && ch <= 'Z' ) || ch == '_';
 }
 
-string
-readToEof( std::istream &ist )
+std::string_view
+trimRightView( std::string_view s )
 {
-	const int N=256;
-	char buf[N];
-	int n;
+	size_t e=s.size();
 
-	ostringstream ost(ios_base::out | ios_base::binary);
+	while( e > 0 && isSpaceChar( s[e-1] ) )
+		--e;
 
-	while( ! ist.eof()  ) {
-		if( ist.read(buf, N).fail() && ! ist.eof() ) {
-			cerr << "ERROR 1: readToEof\n";
-			break;
-		}
+	return s.substr( 0, e );
+}
 
-		n=ist.gcount();
+std::string_view
+trimView( std::string_view s )
+{
+	size_t b=0;
 
-		if( n > 0 && ost.write( buf, n ).fail() ){
-			cerr << "ERROR 2: readToEof\n";
-			break;
-		}
-	}
+	s=trimRightView( s );
 
-	return ost.str();
+	while( b < s.size() && isSpaceChar( s[b] ) )
+		++b;
+
+	return s.substr( b );
 }
 
+/**
+ * The size of the BUFR message at the start of \a data, from the
+ * length in octet 5-7 of section 0. The message must end with the
+ * end section '7777'. The editions before 2 has no length in section
+ * 0, and for them, or if the length is not a complete message, the
+ * size of \a data is returned.
+ */
+size_t
+bufrMessageSize( std::string_view data )
+{
+	const unsigned char *p=reinterpret_cast<const unsigned char*>( data.data() );
+	size_t n;
+
+	if( data.size() < 8 || p[7] < 2 )
+		return data.size();
+
+	n=( static_cast<size_t>( p[4] ) << 16 ) | ( p[5] << 8 ) | p[6];
 
+	if( n < 12 || n > data.size() || data.substr( n - 4, 4 ) != "7777" )
+		return data.size();
+
+	return n;
+}
+
+/**
+ * Base64 encode \a head followed by \a data to \a out, without joining
+ * them in one buffer first. \a head is encoded up to the last whole
+ * group of 3 bytes, the bytes left is encoded together with the first
+ * bytes of \a data.
+ */
 void
-skip( std::istream &ist, const char *what )
+encode64( std::string_view head, std::string_view data, std::string &out )
 {
-	char ch;
+	char group[3];
+	size_t nHead=head.size() - head.size() % 3;
+	size_t nGroup=head.size() - nHead;
+	char *p;
 
-	while( !ist.eof() ) {
-		if( ist.get( ch ).fail() )
-			return;
+	out.resize( wmoraport::base64Size( head.size() + data.size() ) );
+	p=wmoraport::encodeBase64( head.data(), nHead, &out[0] );
 
-		if( ! validChar( ch, what ) ) {
-			ist.putback( ch );
-			return;
-		}
+	if( nGroup > 0 ) {
+		size_t nData=std::min( 3 - nGroup, data.size() );
+
+		head.copy( group, nGroup, nHead );
+		data.copy( group + nGroup, nData );
+		p=wmoraport::encodeBase64( group, nGroup + nData, p );
+		data.remove_prefix( nData );
 	}
+
+	wmoraport::encodeBase64( data.data(), data.size(), p );
 }
 
+/**
+ * Split a SYNOP report in the section line and the rest. The section
+ * line is 'AAXX YYGGi', 'BBXX' or 'OOXX MiMiMjMj', and \a section is
+ * empty if \a report does not start with one. The split is the same
+ * as the regular expression "(^ *((AA|BB|OO)XX *(\d{4}.)? *(\w+)?))?(.*)"
+ * did, \a section is group 2 and \a rest is group 6.
+ */
+void
+splitSynopSection( std::string_view report, std::string_view &section,
+		std::string_view &rest )
+{
+	size_t n=report.size();
+	size_t b=0;
+	size_t i;
+
+	while( b < n && report[b] == ' ' )
+		++b;
+
+	if( n - b < 4 || report[b+2] != 'X' || report[b+3] != 'X' ||
+		report[b] != report[b+1] ||
+		( report[b] != 'A' && report[b] != 'B' && report[b] != 'O' ) ) {
+		section=std::string_view();
+		rest=report;
+		return;
+	}
+
+	for( i=b+4; i < n && report[i] == ' '; ++i );
+
+	if( n - i > 4 && isDigitChar( report[i] ) && isDigitChar( report[i+1] ) &&
+		isDigitChar( report[i+2] ) && isDigitChar( report[i+3] ) )
+		i+=5;
 
+	for( ; i < n && report[i] == ' '; ++i );
+	for( ; i < n && isWordChar( report[i] ); ++i );
 
+	section=report.substr( b, i - b );
+	rest=report.substr( i );
+}
+
+/**
+ * Is a trimmed SYNOP report 'IIiii NIL=', with optional station
+ * number and '='. As the regular expression "^\\s*(\\d+)? *NIL *=?\\s*".
+ */
 bool
-findZCZC( std::istream &ist, std::string &theZCZCline )
-{
-	const char *ZCZC="ZCZC";
-	const char *validch=" 1234567890\r\n";
-	int izc=0;
-	char ch,prevch;
-	bool found=false;
-	bool isValidCh;
-	theZCZCline.erase();
-
-	//Search for the start of message (ZCZC nnn).
-	//nnnn is optional.
-	while( ! found && ! ist.eof() ) {
-		if( ist.get( ch ).fail() && ! ist.eof())
-			return false;
+isNilSynop( std::string_view report )
+{
+	size_t n=report.size();
+	size_t i=0;
 
-		if( ch == ZCZC[izc] ) {
-			theZCZCline.push_back( ch );
-			++izc;
-		} else {
-			izc=0;
-			if( ZCZC[izc] != '\0')
-				theZCZCline.erase();
-		}
+	while( i < n && isDigitChar( report[i] ) )
+		++i;
 
+	while( i < n && report[i] == ' ' )
+		++i;
 
-		if( ZCZC[izc] == '\0' ) //We have found ZCZC
-			found = true;
-	}
+	if( report.substr( i, 3 ) != "NIL" )
+		return false;
 
-	if( ! found ) return false;
+	for( i+=3; i < n && report[i] == ' '; ++i );
 
-	do {
-		prevch=ch;
-		if( ist.get( ch ).fail() && ! ist.eof())
+	if( i < n && report[i] == '=' )
+		++i;
+
+	return i == n;
+}
+
+/**
+ * The keyword of a METAR or SPECI report, and the report after it.
+ */
+struct MetarTokens {
+	std::string_view keyword; ///< METAR or SPECI.
+	std::string_view report;  ///< The report after the keyword, trimmed.
+};
+
+/**
+ * Get the next group, separated by spaces, from \a s at \a i.
+ */
+std::string_view
+nextGroup( std::string_view s, size_t &i )
+{
+	size_t b;
+
+	for( ; i < s.size() && s[i] == ' '; ++i );
+	for( b=i; i < s.size() && ! isSpaceChar( s[i] ); ++i );
+
+	return s.substr( b, i - b );
+}
+
+bool
+isIcao( std::string_view g )
+{
+	if( g.size() != 4 )
+		return false;
+
+	for( char ch : g )
+		if( ch < 'A' || ch > 'Z' )
 			return false;
 
-		isValidCh = validChar( ch, validch);
+	return true;
+}
 
-		if( isValidCh )
-			theZCZCline.push_back( ch );
+bool
+isMetarTime( std::string_view g )
+{
+	if( g.size() != 7 || g[6] != 'Z' )
+		return false;
 
-	}while( isValidCh );
+	for( size_t i=0; i < 6; ++i )
+		if( ! isDigitChar( g[i] ) )
+			return false;
 
-	ist.putback( ch );
-	miutil::trimstr( theZCZCline );
-	return prevch == '\n';
+	return true;
 }
 
+/**
+ * Tokenize a METAR or SPECI report. The keyword and the report is
+ * split as the regular expression "(^ *(METAR|SPECI))?(.*)" did, and
+ * the report is trimmed. When the report does not start with the
+ * keyword, it belongs to the keyword of the report before it.
+ *
+ * The groups at the start of the report, '[COR] CCCC YYGGggZ [AUTO]',
+ * is set in \a fields. They is views into the report, and is empty if
+ * they are missing.
+ */
+void
+tokenizeMetar( std::string_view report, MetarTokens &tokens,
+		wmoraport::ReportFields &fields )
+{
+	size_t b=0;
+
+	while( b < report.size() && report[b] == ' ' )
+		++b;
+
+	std::string_view keyword=report.substr( b, 5 );
+
+	if( keyword == "METAR" || keyword == "SPECI" ) {
+		tokens.keyword=keyword;
+		tokens.report=trimView( report.substr( b + 5 ) );
+	} else {
+		tokens.keyword=std::string_view();
+		tokens.report=trimView( report );
+	}
+
+	size_t i=0;
+	std::string_view g=nextGroup( tokens.report, i );
+
+	fields.cor=( g == "COR" );
+
+	if( fields.cor )
+		g=nextGroup( tokens.report, i );
 
+	fields.icao=std::string_view();
+	fields.time=std::string_view();
+	fields.isAuto=false;
 
+	if( ! isIcao( g ) )
+		return;
+
+	fields.icao=g;
+	g=nextGroup( tokens.report, i );
+
+	if( ! isMetarTime( g ) )
+		return;
+
+	fields.time=g;
+
+	fields.isAuto=( nextGroup( tokens.report, i ) == "AUTO" );
+}
 
 }
 
@@ -209,14 +359,16 @@ wmoraportToString( wmoraport::WmoRaport raport )
 
 
 WMORaport::WMORaport(bool warnAsError_):
-				  warnAsError(warnAsError_)
+				  lastInfo_(NO_REPORT), warnAsError(warnAsError_), sink(nullptr)
 {
 }
 
 WMORaport::WMORaport(const WMORaport &r):
-        														synop_(r.synop_),temp_(r.temp_), metar_(r.metar_), pilo_(r.pilo_),
-        														arep_(r.arep_), drau_(r.drau_),bath_(r.bath_), tide_(r.tide_)
+	arena_(r.arena_), reports_(r.reports_), infos_(r.infos_),
+	lastInfo_(r.lastInfo_), warnAsError(r.warnAsError), sink(nullptr)
 {
+	for( int i=0; i<=wmoraport::BUFR_SURFACE; ++i )
+		sortedInfos_[i]=r.sortedInfos_[i];
 }
 
 WMORaport::~WMORaport()
@@ -228,443 +380,307 @@ WMORaport&
 WMORaport::operator=(const WMORaport &rhs)
 {
 	if(this!=&rhs){
-		synop_=rhs.synop_;
-		temp_=rhs.temp_;
-		metar_=rhs.metar_;
-		pilo_=rhs.pilo_;
-		arep_=rhs.arep_;
-		drau_=rhs.drau_;
-		bath_=rhs.bath_;
-		tide_=rhs.tide_;
+		arena_=rhs.arena_;
+		reports_=rhs.reports_;
+		infos_=rhs.infos_;
+		lastInfo_=rhs.lastInfo_;
+
+		for( int i=0; i<=wmoraport::BUFR_SURFACE; ++i )
+			sortedInfos_[i]=rhs.sortedInfos_[i];
 	}
 	return *this;
 }
 
-std::string
+void
 WMORaport::
-skipEmptyLines( std::istream &ist )const
+addReport( wmoraport::WmoRaport type, const MsgInfo &info, std::string &&report )
 {
-	ostringstream line;
-	char ch;
-
-	skip( ist, " \t\r\n" );
-
-	while(  ! ist.eof() ) {
-		if( ist.get( ch ).fail() && ! ist.eof())
-			break;;
-
-		if( isalnum(ch) || validChar(ch, " /=")) {
-			line << ch;
-		} else {
-			skip( ist, "\t\r\n" );
-			break;
-		}
-	}
-
-	return line.str();
+	if( sink && ! trimView( info.what ).empty() )
+		sink->report( type, info, fields, std::move( report ) );
+	else
+		addReport( type, info, std::string_view( report ) );
 }
 
-
-bool
+void
 WMORaport::
-readReport( std::istream &ist, std::string &report)const
+addReport( wmoraport::WmoRaport type, const MsgInfo &info, std::string_view report )
 {
-	ostringstream buf;
-	string::size_type i;
-	string line;
+	//Reports without a type, ie. a SYNOP without AAXX, is dropped.
+	if( trimView( info.what ).empty() )
+		return;
 
-	report.erase();
-	line = skipEmptyLines( ist );
-
-	if( line.empty() )
-		return false;
+	if( sink ) {
+		sink->report( type, info, fields, report );
+		return;
+	}
 
-	do {
-		boost::trim_right( line );
-		i = line.find("=");
-
-		if( i != string::npos ) {
-			line.erase( i+1 ); //Clean eventually rubbish from the end.
-			buf << line << "\n";
-			report = buf.str();
-			return true;
-		} else {
-			buf << line << "\n";
+	//Intern the MsgInfo, the reports from a bulletin usually have the
+	//same MsgInfo as the report before.
+	if( lastInfo_ == NO_REPORT || infos_[lastInfo_].type != type ||
+		infos_[lastInfo_].info.what != info.what ) {
+		std::vector<unsigned> &sorted=sortedInfos_[type];
+		std::vector<unsigned>::iterator it=std::lower_bound(
+				sorted.begin(), sorted.end(), info.what,
+				[this]( unsigned i, const std::string &what ) {
+					return infos_[i].info.what < what;
+				} );
+
+		if( it == sorted.end() || infos_[*it].info.what != info.what ) {
+			Info newInfo={ info, type, NO_REPORT, NO_REPORT };
+			infos_.push_back( newInfo );
+			it=sorted.insert( it, infos_.size() - 1 );
 		}
-	}while( getline( ist, line, '\n') );
-
-	line = buf.str();
 
-	if( ! boost::trim_copy( line ).empty() ) {
-		report = line + "\n";
-		return true;
+		lastInfo_=*it;
 	}
 
-	return false;
-}
+	Info &theInfo=infos_[lastInfo_];
+	Report r={ arena_.size(), report.size(), NO_REPORT };
+	unsigned i=reports_.size();
 
-void
-WMORaport::
-removeEmptyKeys( MsgMap &msgMap )
-{
-	MsgMap::iterator itTmp;
-	MsgMap::iterator it=msgMap.begin();
-
-	while( it != msgMap.end() ) {
-		if( boost::trim_copy(it->first.what) == "" ) {
-			itTmp = it;
-			++it;
-			msgMap.erase( itTmp );
-		}else {
-			++it;
-		}
-	}
+	arena_.append( report );
+	reports_.push_back( r );
+
+	if( theInfo.last == NO_REPORT )
+		theInfo.first=i;
+	else
+		reports_[theInfo.last].next=i;
+
+	theInfo.last=i;
 }
 
 
 bool
 WMORaport::
-doSYNOP( std::istream &ist, const std::string &header, const std::string &theZCZCline )
+doSYNOP( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline )
 {
 	bool skip = false;
-	string line;
-	cmatch what;
-	string ident;
+	std::string_view line;
+	MsgInfo ident( "", true );
+	std::string_view section;
+	std::string_view report;
 
-	if( ! readReport( ist, line ) )
+	if( ! reports.next( line ) )
 		return true;
 
 	do {
-		boost::trim_right( line );
-		if( ! regex_match( line.c_str(), what, ::synopType ) ){
-			//This should never happend
-			continue;
-		} else {
-			if( what[2].length() > 0 ) {
-				ident = what[2];
-				if( what[3] == "OO" ) skip = true; //SYNOP mobile
-				else skip = false;
-			}
-
-
-			line = what[6];
-			if( line.empty() )
-				continue;
+		line = trimRightView( line );
+		//The regular expressions used to stop at a NUL, keep that.
+		line = line.substr( 0, line.find( '\0' ) );
+		splitSynopSection( line, section, report );
+
+		if( ! section.empty() ) {
+			ident.what = section;
+			skip = ( section[0] == 'O' ); //SYNOP mobile
+		}
 
+		if( report.empty() )
+			continue;
 
-			if( ! skip && ! ident.empty()  ) {
-				boost::trim( line );
-				if( ! regex_match( line.c_str(), what, ::synopIsNil ) ){
-					synop_[MsgInfo(ident, true)].push_back( line );
-				}
-			}
+		if( ! skip && ! ident.what.empty()  ) {
+			report = trimView( report );
+			if( ! isNilSynop( report ) )
+				addReport( wmoraport::SYNOP, ident, report );
 		}
-	}while( readReport( ist, line ) );
-
-	removeEmptyKeys( synop_ );
+	}while( reports.next( line ) );
 
 	return true;
 }
 
 bool
 WMORaport::
-doMETAR( std::istream &ist, const std::string &header, const std::string &theZCZCline )
+doMETAR( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline )
 {
-	string line;
-	cmatch what;
-	string ident;
+	std::string_view line;
+	MsgInfo ident( "", true );
+	MetarTokens tokens;
 
-	if( ! readReport( ist, line ) )
+	if( ! reports.next( line ) )
 		return true;
 
 	do {
-		if( ! regex_match( line.c_str(), what, ::metarType ) ){
-			//This should never happend.
-			continue;
-		}else {
-			if( what[2].length() != 0 )
-				ident = what[2];
-
-			line = what[3];
-			boost::trim( line );
+		//The regular expression used to stop at a NUL, keep that.
+		tokenizeMetar( line.substr( 0, line.find( '\0' ) ), tokens, fields );
 
-			if( line.empty() )
-				continue;
-
-			metar_[MsgInfo(ident, true)].push_back( line );
+		if( ! tokens.keyword.empty() ) {
+			ident.what = tokens.keyword;
+			ident.priority = ( ident.what == "SPECI" );
 		}
-	} while( readReport( ist, line ) );
 
-	removeEmptyKeys( metar_ );
+		if( tokens.report.empty() )
+			continue;
+
+		addReport( wmoraport::METAR, ident, tokens.report );
+	} while( reports.next( line ) );
 	return true;
 }
 
 bool
 WMORaport::
-doTEMP( std::istream &ist, const std::string &header, const std::string &theZCZCline )
+doTEMP( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline )
 {
-	errorStr << "TEMP: not implemented: " << header << endl;
+	errorStr << "TEMP: not implemented: " << header.line << endl;
 	return true;
 }
 
 bool
 WMORaport::
-doPILO( std::istream &ist, const std::string &header, const std::string &theZCZCline )
+doPILO( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline )
 {
-	errorStr << "PILO: not implemented: " << header << endl;
+	errorStr << "PILO: not implemented: " << header.line << endl;
 	return true;
 }
 
 bool
 WMORaport::
-doAREP( std::istream &ist, const std::string &header, const std::string &theZCZCline )
+doAREP( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline )
 {
-	errorStr << "AREP: not implemented: " << header << endl;
+	errorStr << "AREP: not implemented: " << header.line << endl;
 	return true;
 }
 
 bool
 WMORaport::
-doDRAU( std::istream &ist, const std::string &header, const std::string &theZCZCline )
+doDRAU( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline )
 {
-	errorStr << "DRAU: not implemented: " << header << endl;
+	errorStr << "DRAU: not implemented: " << header.line << endl;
 	return true;
 }
 
 bool
 WMORaport::
-doBATH( std::istream &ist, const std::string &header, const std::string &theZCZCline )
+doBATH( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline )
 {
-	errorStr << "BATH: not implemented: " << header << endl;
+	errorStr << "BATH: not implemented: " << header.line << endl;
 	return true;
 }
 
 bool
 WMORaport::
-doTIDE( std::istream &ist, const std::string &header, const std::string &theZCZCline )
+doTIDE( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline )
 {
-	errorStr << "TIDE: not implemented: " << header << endl;
+	errorStr << "TIDE: not implemented: " << header.line << endl;
 	return true;
 }
 
 bool
 WMORaport::
-doBUFR_SURFACE( std::istream &ist, const std::string &header, const std::string &theZCZCline )
+doBUFR_SURFACE( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline )
 {
-	static int count=0;
-	++count;
-	string data;
+	std::string_view data;
+	string head;
 	string bufr;
-	ostringstream ost;
 
-	data = readToEof( ist );
+	data = reports.rest();
 
-	if( data.size() < 4 || data.substr(0, 4) != "BUFR") {
+	if( data.size() < 4 || data.substr(0, 4) != "BUFR")
 		return false;
-	} else {
-		if( data.substr(0, 4) != "BUFR" )
-			return false;
 
-		ost << theZCZCline << "\n" <<  header << "\n" << data;
-		data = ost.str();
-		miutil::encode64( data.data(), data.size(), bufr );
-		bufrSurface_[MsgInfo("bufr_surface", "encoding=base64", false)].push_back( bufr );
-		return true;
-	}
+	//Ignore what is after the BUFR message. The message is encoded
+	//where it is in the bulletin.
+	data = data.substr( 0, bufrMessageSize( data ) );
+	head = theZCZCline;
+	head += "\n";
+	head += header.line;
+	head += "\n";
+	encode64( head, data, bufr );
+	addReport( wmoraport::BUFR_SURFACE,
+			MsgInfo("bufr_surface", "encoding=base64", false), std::move( bufr ) );
+	return true;
 }
 
 
 bool
 WMORaport::
-doDispatch( doRaport func, wmoraport::WmoRaport raportType,
-		std::istream &ist,  const string &header, const std::string &theZCZCline )
+doDispatch( doRaport func, wmoraport::ReportIterator &reports,
+		const wmoraport::GtsHeader &header, const std::string &theZCZCline )
 {
 	if( ! raportsToCollect.empty() &&
-			raportsToCollect.find( raportType ) == raportsToCollect.end() )
+			raportsToCollect.find( header.type ) == raportsToCollect.end() )
 		return true;
 
-	return (this->*func)( ist, header, theZCZCline );
+	return (this->*func)( reports, header, theZCZCline );
 }
 
 bool
 WMORaport::
-dispatch( std::istream &ist, const std::string &theZCZCline )
+dispatch( std::string_view bulletin, const std::string &theZCZCline )
 {
-	cmatch what;
-	string buf;
+	std::string_view buf;
+	wmoraport::GtsHeader header;
+	wmoraport::ReportIterator reports( bulletin );
 
 	//Skip blank lines at the beginning and get the first line. This is the GTS header.
-	buf = skipEmptyLines( ist );
+	buf = reports.line();
 
 	if( buf.empty() )
 		return true;
 
-	//boost::trim( buf );
-
-	if(regex_match(buf.c_str(), what, ::synop)){
-		return doDispatch( &WMORaport::doSYNOP, wmoraport::SYNOP,
-				ist, buf, theZCZCline );
-	}else if(regex_match(buf.c_str(), what, ::metar)){
-		return doDispatch( &WMORaport::doMETAR, wmoraport::METAR,
-				ist, buf, theZCZCline );
-	}else if(regex_match(buf.c_str(), what, ::temp)){
-		return doDispatch( &WMORaport::doTEMP, wmoraport::TEMP,
-				ist, buf, theZCZCline );
-	}else if(regex_match(buf.c_str(), what, ::pilo)){
-		return doDispatch( &WMORaport::doPILO, wmoraport::PILO,
-				ist, buf, theZCZCline );
-	}else if(regex_match(buf.c_str(), what, ::arep)){
-		return doDispatch( &WMORaport::doAREP, wmoraport::AREP,
-				ist, buf, theZCZCline );
-	}else if(regex_match(buf.c_str(), what, ::drau)){
-		return doDispatch( &WMORaport::doDRAU, wmoraport::DRAU,
-				ist, buf, theZCZCline );
-	}else if(regex_match(buf.c_str(), what, ::bath)){
-		return doDispatch( &WMORaport::doBATH, wmoraport::BATH,
-				ist, buf, theZCZCline );
-	}else if(regex_match(buf.c_str(), what, ::tide)){
-		return doDispatch( &WMORaport::doTIDE, wmoraport::TIDE,
-				ist, buf, theZCZCline );
-	}else if(regex_match(buf.c_str(), what, ::bufrSurface)){
-		return doDispatch( &WMORaport::doBUFR_SURFACE, wmoraport::BUFR_SURFACE,
-				ist, buf, theZCZCline );
-	}else {
+	if( ! wmoraport::parseGtsHeader( buf, header ) || ! header.known ) {
 		//errorStr << "UNKNOWN: bulletin: " << buf << endl;
 		return true;
 		//Unknown bulentin
 	}
-}
 
-
-
-/**
- * A message starts with the sequence "ZCZC nnn\r\r\n" or
- * "ZCZC\r\r\n", ie nnn is optional. nnn represent a sequence
- * number in which the message are sendt.
- *
- * A message ends with the sequence "\n\n\n\n\n\n\nNNNN\r\r\n"
- *
- * The routine collects all data between the start sequence
- * and end sequence, excluding the sequence itself, and returns
- * the data in param msg.
- *
- * @param ist the input stream to collect data from.
- * @param[out] msg the collected data.
- */
-bool
-WMORaport::
-getMessage( std::istream &ist, std::ostream &msg, std::string &theZCZCline )
-{
-	const char *NNNN="NNNN";
-	int iNNN=0;
-	char ch, prevCh;
-	int rnCount=0;
-	int count=0;
-	bool complite = false;
-	bool error=false;
-	string buf;
-	ostringstream ost( ios_base::out | ios_base::binary );
-
-	//Search for the start of message (ZCZC nnn).
-	//nnnn is optional.
-	if( ! findZCZC( ist, theZCZCline ) ) {
-		cerr << "Cant find ZCZC"<< endl;
-		return false;
+	bool ret=true;
+
+	//The sink gets the heading with the reports, it is only valid
+	//while the bulletin is dispatched.
+	fields=wmoraport::ReportFields();
+	fields.header=&header;
+
+	switch( header.type ) {
+	case wmoraport::SYNOP:
+		ret=doDispatch( &WMORaport::doSYNOP, reports, header, theZCZCline );
+		break;
+	case wmoraport::METAR:
+		ret=doDispatch( &WMORaport::doMETAR, reports, header, theZCZCline );
+		break;
+	case wmoraport::TEMP:
+		ret=doDispatch( &WMORaport::doTEMP, reports, header, theZCZCline );
+		break;
+	case wmoraport::PILO:
+		ret=doDispatch( &WMORaport::doPILO, reports, header, theZCZCline );
+		break;
+	case wmoraport::AREP:
+		ret=doDispatch( &WMORaport::doAREP, reports, header, theZCZCline );
+		break;
+	case wmoraport::DRAU:
+		ret=doDispatch( &WMORaport::doDRAU, reports, header, theZCZCline );
+		break;
+	case wmoraport::BATH:
+		ret=doDispatch( &WMORaport::doBATH, reports, header, theZCZCline );
+		break;
+	case wmoraport::TIDE:
+		ret=doDispatch( &WMORaport::doTIDE, reports, header, theZCZCline );
+		break;
+	case wmoraport::BUFR_SURFACE:
+		ret=doDispatch( &WMORaport::doBUFR_SURFACE, reports, header, theZCZCline );
+		break;
 	}
 
-	//Search for the end mark (NNNN).
-	while( !ist.eof() ) {
-		if( ist.get( ch ).fail() )
-			return false;
-
-		ost << ch;
-
-		if( NNNN[iNNN] == ch || ch == '\n' || ch == '\r' ) {
-			++count;
-			if( NNNN[iNNN] == ch ) {
-				++iNNN;
-			} else {
-				++rnCount;
-				iNNN = 0;
-			}
-		} else {
-			count=0;
-			iNNN=0;
-			rnCount=0;
-		}
-
-		if( ! NNNN[iNNN] && rnCount > 2 ) {
-			rnCount=0;
-			while( true ) {
-				prevCh = ch;
-
-				if( ist.get( ch ).fail()  ) {
-					if( rnCount > 0 && ist.eof() ) {
-						buf=ost.str();
-						///Remove the last count chars from the buf, this is \n\n\n\n\n\n\nNNNN\r\r\n.
-						buf.erase( buf.size() - count );
-						msg << buf;
-						return true;
-					} else {
-						return false;
-					}
-				}
-
-				if( prevCh == '\n' && rnCount > 0 ) {
-					ist.putback( ch );
-					buf=ost.str();
-
-					///Remove the last count chars from the buf, this is \n\n\n\n\n\n\nNNNN\r\r\n.
-					buf.erase( buf.size() - count );
-					msg << buf;
-					return true;
-				} else if( validChar( ch, "\r\n") ) {
-					++rnCount;
-					++count;
-					ost << ch;
-				} else {
-					return false;
-				}
-			}
-		}
-	}
-
-	buf = ost.str();
-
-	if( buf.size() == 0 )
-		return false;
-
-	msg << buf;
-	//We have reached the end of the input stream
-	//without finding the end mark (NNNN). We
-	//pretend the end mark is found and return true
-	//anyway.
-	return true;
+	fields=wmoraport::ReportFields();
+	return ret;
 }
 
 
+
 bool
 WMORaport::
-decode(std::istream &ist)
+decode( std::string_view raport )
 {
-	stringstream msg( ios_base::out | ios_base::in | ios_base::binary );
-	string tmp;
-	string theZCZCline;
-	int i=0;
+	wmoraport::BulletinFramer framer( raport );
+	wmoraport::Bulletin bulletin;
 
 	notMatchedInGetMessage.str("");
 
-	while( ! ist.eof() ){
-		if( getMessage( ist, msg, theZCZCline ) ) {
-			tmp = msg.str();
-			if( ! dispatch( msg, theZCZCline ) ) {
-				errorStr << "ERROR: can't split bulletin segment[" << endl
-						<< tmp << "]" << endl;
-			}
+	while( framer.next( bulletin ) ) {
+		std::string_view body=framer.body( bulletin );
+
+		if( ! dispatch( body, string( framer.zczcLine( bulletin ) ) ) ) {
+			errorStr << "ERROR: can't split bulletin segment[" << endl
+					<< body << "]" << endl;
 		}
-		msg.clear();
-		msg.str("");
-		++i;
 	}
 
 	string error=boost::trim_copy( notMatchedInGetMessage.str() );
@@ -678,17 +694,25 @@ decode(std::istream &ist)
 }
 
 bool
-WMORaport::split(const std::string &raport,
+WMORaport::split(std::string_view raport,
 		const wmoraport::WmoRaports &collectRaports )
 {
-	std::istringstream inputStream( ios_base::in | ios_base::binary);
-	string msg(raport);
+	errorStr.str("");
+	raportsToCollect = collectRaports;
+	sink = nullptr;
+	return decode( raport );
+}
 
+bool
+WMORaport::split(std::string_view raport, WMORaportSink &sink_,
+		const wmoraport::WmoRaports &collectRaports )
+{
 	errorStr.str("");
-	//   cleanCR(msg);
-	inputStream.str(msg);
 	raportsToCollect = collectRaports;
-	return decode(inputStream);
+	sink = &sink_;
+	bool ret=decode( raport );
+	sink = nullptr;
+	return ret;
 }
 
 
@@ -696,136 +720,70 @@ std::ostream&
 operator<<(std::ostream& output,
 		const WMORaport& r)
 {
-	WMORaport::CIMsgMap  itm;
-	WMORaport::CIMsgList itl;
+	WMORaport::MsgMap msgMap=r.msgMap( wmoraport::SYNOP );
 
-	if( r.synop_.begin() != r.synop_.end() ) {
+	if( ! msgMap.empty() ) {
 		output << " ---- SYNOP BEGIN ----" << endl;
-		for( itm=r.synop_.begin();
-				itm!=r.synop_.end(); itm++){
-			output << "<<" << itm->first.what <<">>" << endl;
-			for(itl=itm->second.begin();
-					itl!=itm->second.end();
-					itl++){
-				output << "["<< *itl <<"]"<< endl;
-			}
+		for( WMORaport::MsgMap::value_type msgs : msgMap ) {
+			output << "<<" << msgs.first.what <<">>" << endl;
+			for( std::string_view msg : msgs.second )
+				output << "["<< msg <<"]"<< endl;
 
 			output << endl;
 		}
 		output << " ---- SYNOP END ----" << endl;
 	}
 
-	if( r.temp_.begin() != r.temp_.end() ) {
+	msgMap=r.msgMap( wmoraport::TEMP );
+
+	if( ! msgMap.empty() ) {
 		output << " ---- TEMP BEGIN ----" << endl;
-		for(itm=r.temp_.begin();
-				itm!=r.temp_.end();
-				itm++){
-			output << itm->first.what << endl;
-			for(itl=itm->second.begin();
-					itl!=itm->second.end();
-					itl++){
-				output << *itl << endl;
-			}
+		for( WMORaport::MsgMap::value_type msgs : msgMap ) {
+			output << msgs.first.what << endl;
+			for( std::string_view msg : msgs.second )
+				output << msg << endl;
+
 			output << endl;
 		}
 		output << " ---- TEMP END ----" << endl;
 	}
 
-	if( r.metar_.begin() != r.metar_.end() ) {
+	msgMap=r.msgMap( wmoraport::METAR );
+
+	if( ! msgMap.empty() ) {
 		output << " ---- METAR BEGIN ----" << endl;
-		for(itm=r.metar_.begin();
-				itm!=r.metar_.end();
-				itm++){
-			output << "<<" << itm->first.what <<">>"<< endl;
-			for(itl=itm->second.begin();
-					itl!=itm->second.end();
-					itl++){
-				output << *itl << endl;
-			}
+		for( WMORaport::MsgMap::value_type msgs : msgMap ) {
+			output << "<<" << msgs.first.what <<">>"<< endl;
+			for( std::string_view msg : msgs.second )
+				output << msg << endl;
 
 			output << endl;
 		}
 		output << " ---- METAR END ----" << endl;
 	}
 
-	if( r.pilo_.begin() != r.pilo_.end()) {
-		for(itm=r.pilo_.begin();
-				itm!=r.pilo_.end();
-				itm++){
-			output << itm->first.what << endl;
-			for(itl=itm->second.begin();
-					itl!=itm->second.end();
-					itl++){
-				output << *itl;
-			}
-
-			output << endl;
-		}
-	}
-
-	for(itm=r.arep_.begin();
-			itm!=r.arep_.end();
-			itm++){
-		output << itm->first.what << endl;
-		for(itl=itm->second.begin();
-				itl!=itm->second.end();
-				itl++){
-			output << *itl;
-		}
-
-		output << endl;
-	}
+	const wmoraport::WmoRaport others[]={ wmoraport::PILO, wmoraport::AREP,
+			wmoraport::DRAU, wmoraport::BATH, wmoraport::TIDE };
 
-	for(itm=r.drau_.begin();
-			itm!=r.drau_.end();
-			itm++){
-		output << itm->first.what << endl;
-		for(itl=itm->second.begin();
-				itl!=itm->second.end();
-				itl++){
-			output << *itl;
-		}
-
-		output << endl;
-	}
+	for( wmoraport::WmoRaport type : others ) {
+		for( WMORaport::MsgMap::value_type msgs : r.msgMap( type ) ) {
+			output << msgs.first.what << endl;
+			for( std::string_view msg : msgs.second )
+				output << msg;
 
-	for(itm=r.bath_.begin();
-			itm!=r.bath_.end();
-			itm++){
-		output << itm->first.what << endl;
-		for(itl=itm->second.begin();
-				itl!=itm->second.end();
-				itl++){
-			output << *itl;
-		}
-
-		output << endl;
-	}
-
-	for(itm=r.tide_.begin();
-			itm!=r.tide_.end();
-			itm++){
-		output << itm->first.what << endl;
-		for(itl=itm->second.begin();
-				itl!=itm->second.end();
-				itl++){
-			output << *itl;
+			output << endl;
 		}
-		output << endl;
 	}
 
+	msgMap=r.msgMap( wmoraport::BUFR_SURFACE );
 
-	if( r.bufrSurface_.begin() != r.bufrSurface_.end()) {
+	if( ! msgMap.empty() ) {
 		output << " ---- BUFR BEGIN ----" << endl;
-		for(itm=r.bufrSurface_.begin();
-				itm!=r.bufrSurface_.end();
-				itm++){
-			output << itm->first.what << " (" << itm->first.what << ")"<< endl;
-			for(itl=itm->second.begin();
-					itl!=itm->second.end();
-					itl++){
-				output << itm->first.what  << " (" << itm->first.what << ")" << endl << *itl << endl;
-			}
+		for( WMORaport::MsgMap::value_type msgs : msgMap ) {
+			output << msgs.first.what << " (" << msgs.first.what << ")"<< endl;
+			for( std::string_view msg : msgs.second )
+				output << msgs.first.what  << " (" << msgs.first.what << ")" << endl << msg << endl;
+
 			output << endl;
 		}
 		output << " ---- BUFR END ----" << endl;
@@ -833,23 +791,6 @@ operator<<(std::ostream& output,
 
 	output << endl;
 
-	if(r.errorMap_.begin() != r.errorMap_.end())
-	{
-		output << "-------ERROR MAP (BEGIN) ---------" << endl;
-
-		for(itm=r.errorMap_.begin();
-				itm!=r.errorMap_.end();
-				itm++){
-			output << itm->first.what << endl;
-			for(itl=itm->second.begin();
-					itl!=itm->second.end();
-					itl++){
-				output << *itl;
-			}
-			output << "-------ERROR MAP (END) ---------" << endl;
-		}
-	}
-
 	return output;
 }
 
@@ -861,19 +802,8 @@ getRaports( const wmoraport::WmoRaports &raports )const
 	MsgMapsList ret;
 
 	BOOST_FOREACH( wmoraport::WmoRaport raport, raports ){
-		switch( raport ) {
-		case wmoraport::AREP: ret[wmoraport::AREP] = &arep_; break;
-		case wmoraport::BATH: ret[wmoraport::BATH] = &bath_; break;
-		case wmoraport::DRAU: ret[wmoraport::DRAU ] = &drau_; break;
-		case wmoraport::METAR: ret[wmoraport::METAR] = &metar_; break;
-		case wmoraport::PILO: ret[wmoraport::PILO] = &pilo_; break;
-		case wmoraport::SYNOP: ret[wmoraport::SYNOP] = &synop_; break;
-		case wmoraport::TEMP: ret[wmoraport::TEMP] = &temp_; break;
-		case wmoraport::TIDE: ret[wmoraport::TIDE] = &tide_ ; break;
-		case wmoraport::BUFR_SURFACE: ret[wmoraport::BUFR_SURFACE] = &bufrSurface_; break;
-		default:
-			continue;
-		}
+		if( raport >= wmoraport::SYNOP && raport <= wmoraport::BUFR_SURFACE )
+			ret.insert( make_pair( raport, msgMap( raport ) ) );
 	}
 	return ret;
 }
@@ -30,16 +30,36 @@
 */
 #ifndef __WMORaport_h__
 #define __WMORaport_h__
+#include <stddef.h>
+#include <iterator>
 #include <map> 
 #include <list>
 #include <set>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <vector>
 
 namespace wmoraport {
 typedef enum{SYNOP, METAR, TEMP, PILO,AREP, DRAU, BATH, TIDE,
              BUFR_SURFACE} WmoRaport;
 typedef std::set<WmoRaport> WmoRaports;
+struct GtsHeader;
+class ReportIterator;
+
+/**
+ * What is parsed about a report, besides the MsgInfo, when the
+ * bulletin it is in is split. It is given to the sink with the report,
+ * and is only valid during the call.
+ */
+struct ReportFields {
+	const GtsHeader *header; ///< The heading of the bulletin, TTAAii CCCC YYGGgg [BBB].
+	std::string_view icao;   ///< METAR/SPECI: The location indicator, CCCC.
+	std::string_view time;   ///< METAR/SPECI: The observation time, YYGGggZ.
+	bool             cor;    ///< METAR/SPECI: A corrected report.
+	bool             isAuto; ///< METAR/SPECI: A fully automated report.
+	ReportFields():header(nullptr), cor(false), isAuto(false){}
+};
 }
 
 std::string
@@ -49,71 +69,193 @@ struct MsgInfo {
 	std::string what;
 	std::string decoderExtra;
 	bool addWhatInFront;
-	MsgInfo():addWhatInFront(false){}
-	MsgInfo( const std::string &what, bool whatInFront=true ):what( what ), addWhatInFront( whatInFront ){}
+	bool priority; ///< Send before the other reports, ie. SPECI.
+	MsgInfo():addWhatInFront(false), priority(false){}
+	MsgInfo( const std::string &what, bool whatInFront=true ):what( what ), addWhatInFront( whatInFront ), priority(false){}
 	MsgInfo( const std::string &what_, const std::string &decoderExtra_, bool whatInFront=false )
-		:what( what_ ), decoderExtra( decoderExtra_ ), addWhatInFront( whatInFront ){}
+		:what( what_ ), decoderExtra( decoderExtra_ ), addWhatInFront( whatInFront ), priority(false){}
 	bool operator<(const MsgInfo &rhs )const { return what < rhs.what; }
 };
 
+/**
+ * Receives the reports from WMORaport::split as they are found, in
+ * the order they are in the input.
+ */
+class WMORaportSink {
+ public:
+  virtual ~WMORaportSink(){}
+
+  /**
+   * A report is found. \a fields and \a report is only valid during
+   * the call.
+   */
+  virtual void report( wmoraport::WmoRaport type, const MsgInfo &info,
+                       const wmoraport::ReportFields &fields,
+                       std::string_view report )=0;
+
+  /**
+   * A report is found in a buffer of its own, ie. an encoded BUFR
+   * message. The sink may move from \a report.
+   */
+  virtual void report( wmoraport::WmoRaport type, const MsgInfo &info,
+                       const wmoraport::ReportFields &fields,
+                       std::string &&report ){
+    this->report( type, info, fields, std::string_view( report ) );
+  }
+};
+
 class WMORaport{
+  /**
+   * A report, saved in arena_. The reports with the same MsgInfo is
+   * linked together with next.
+   */
+  struct Report {
+    size_t   offset;
+    size_t   size;
+    unsigned next;
+  };
+
+  /**
+   * A MsgInfo, and the first and last of its reports.
+   */
+  struct Info {
+    MsgInfo                info;
+    wmoraport::WmoRaport   type;
+    unsigned               first;
+    unsigned               last;
+  };
+
+  static const unsigned NO_REPORT=~0u;
+
+  std::string           arena_;
+  std::vector<Report>   reports_;
+  std::vector<Info>     infos_;
+  std::vector<unsigned> sortedInfos_[wmoraport::BUFR_SURFACE+1]; //On what.
+  unsigned              lastInfo_;
+
  public:
-  typedef std::list<std::string>                          MsgList;
-  typedef std::list<std::string>::iterator               IMsgList;
-  typedef std::list<std::string>::const_iterator        CIMsgList;
-  typedef std::map<MsgInfo, MsgList >                   MsgMap;
-  typedef std::map<MsgInfo, MsgList >::iterator        IMsgMap;
-  typedef std::map<MsgInfo, MsgList >::const_iterator CIMsgMap;
-  typedef std::map<wmoraport::WmoRaport,const MsgMap*>  MsgMapsList;
+  /**
+   * A view of the reports with the same MsgInfo, in the order they
+   * was found.
+   */
+  class MsgList {
+    const WMORaport *raport_;
+    unsigned         first_;
+
+   public:
+    class const_iterator {
+      const WMORaport *raport_;
+      unsigned         i_;
+
+     public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef std::string_view          value_type;
+      typedef std::ptrdiff_t            difference_type;
+      typedef const std::string_view   *pointer;
+      typedef std::string_view          reference;
+
+      const_iterator( const WMORaport *raport, unsigned i ):raport_( raport ), i_( i ){}
+      std::string_view operator*()const {
+        const Report &r=raport_->reports_[i_];
+        return std::string_view( raport_->arena_ ).substr( r.offset, r.size );
+      }
+      const_iterator &operator++(){ i_=raport_->reports_[i_].next; return *this; }
+      const_iterator operator++(int){ const_iterator it( *this ); ++*this; return it; }
+      bool operator==( const const_iterator &rhs )const { return i_ == rhs.i_; }
+      bool operator!=( const const_iterator &rhs )const { return i_ != rhs.i_; }
+    };
+
+    typedef const_iterator   iterator;
+    typedef std::string_view value_type;
+
+    MsgList( const WMORaport *raport, unsigned first ):raport_( raport ), first_( first ){}
+    const_iterator begin()const { return const_iterator( raport_, first_ ); }
+    const_iterator end()const { return const_iterator( raport_, NO_REPORT ); }
+    bool empty()const { return first_ == NO_REPORT; }
+  };
+
+  /**
+   * A view of the reports of one report type, grouped by MsgInfo and
+   * ordered on MsgInfo::what.
+   */
+  class MsgMap {
+    const WMORaport             *raport_;
+    const std::vector<unsigned> *infos_;
+
+   public:
+    typedef std::pair<const MsgInfo&, MsgList> value_type;
+
+    class const_iterator {
+      const WMORaport                      *raport_;
+      std::vector<unsigned>::const_iterator it_;
+
+     public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef MsgMap::value_type        value_type;
+      typedef std::ptrdiff_t            difference_type;
+      typedef void                      pointer;
+      typedef MsgMap::value_type        reference;
+
+      const_iterator( const WMORaport *raport, std::vector<unsigned>::const_iterator it )
+        :raport_( raport ), it_( it ){}
+      value_type operator*()const {
+        const Info &info=raport_->infos_[*it_];
+        return value_type( info.info, MsgList( raport_, info.first ) );
+      }
+      const_iterator &operator++(){ ++it_; return *this; }
+      const_iterator operator++(int){ const_iterator it( *this ); ++*this; return it; }
+      bool operator==( const const_iterator &rhs )const { return it_ == rhs.it_; }
+      bool operator!=( const const_iterator &rhs )const { return it_ != rhs.it_; }
+    };
+
+    typedef const_iterator iterator;
+
+    MsgMap( const WMORaport *raport, const std::vector<unsigned> *infos )
+      :raport_( raport ), infos_( infos ){}
+    const_iterator begin()const { return const_iterator( raport_, infos_->begin() ); }
+    const_iterator end()const { return const_iterator( raport_, infos_->end() ); }
+    bool empty()const { return infos_->empty(); }
+  };
+
+  typedef std::map<wmoraport::WmoRaport, MsgMap>  MsgMapsList;
 
  protected:
-  typedef bool (WMORaport::*doRaport)( std::istream &ist, const std::string &header, const std::string &theZCZCline );
+  typedef bool (WMORaport::*doRaport)( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline );
 
-  std::string skipEmptyLines( std::istream &ist )const;
-  void removeEmptyKeys( MsgMap &msgMap );
   /**
-   * Read from the inputstream until an "=" sign is read.
-   * It cleans the input for '\r' chars.
-   *
-   * @param ist The inputstream to read from.
-   * @param[out] report The report.
-   * @return true if report is filled with something and false otherwise.
+   * Give \a report to the sink, or save it in arena_ if there is no
+   * sink.
    */
-  bool readReport( std::istream &ist, std::string &report)const;
-
-  bool decode(std::istream &ist);
-  bool dispatch( std::istream &ist, const std::string &theZCZCline );
-  bool getMessage( std::istream &ist, std::ostream &msg, std::string &theZCZCline );
-  bool doDispatch( doRaport func, wmoraport::WmoRaport raportType,
-                   std::istream &ist,  const std::string &header, const std::string &theZCZCline );
-  bool doSYNOP( std::istream &ist, const std::string &header, const std::string &theZCZCline );
-  bool doMETAR( std::istream &ist, const std::string &header, const std::string &theZCZCline );
-  bool doTEMP( std::istream &ist, const std::string &header, const std::string &theZCZCline );
-  bool doPILO( std::istream &ist, const std::string &header, const std::string &theZCZCline );
-  bool doAREP( std::istream &ist, const std::string &header, const std::string &theZCZCline );
-  bool doDRAU( std::istream &ist, const std::string &header, const std::string &theZCZCline );
-  bool doBATH( std::istream &ist, const std::string &header, const std::string &theZCZCline );
-  bool doTIDE( std::istream &ist, const std::string &header, const std::string &theZCZCline );
-  bool doBUFR_SURFACE( std::istream &ist, const std::string &header, const std::string &theZCZCline );
+  void addReport( wmoraport::WmoRaport type, const MsgInfo &info,
+                  std::string_view report );
+
+  /**
+   * As above, but the sink may take over the buffer of \a report.
+   */
+  void addReport( wmoraport::WmoRaport type, const MsgInfo &info,
+                  std::string &&report );
+  bool decode( std::string_view raport );
+  bool dispatch( std::string_view bulletin, const std::string &theZCZCline );
+  bool doDispatch( doRaport func, wmoraport::ReportIterator &reports,
+                   const wmoraport::GtsHeader &header, const std::string &theZCZCline );
+  bool doSYNOP( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline );
+  bool doMETAR( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline );
+  bool doTEMP( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline );
+  bool doPILO( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline );
+  bool doAREP( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline );
+  bool doDRAU( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline );
+  bool doBATH( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline );
+  bool doTIDE( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline );
+  bool doBUFR_SURFACE( wmoraport::ReportIterator &reports, const wmoraport::GtsHeader &header, const std::string &theZCZCline );
 
   std::ostringstream errorStr;
   std::ostringstream notMatchedInGetMessage;
   int lineno;
   bool warnAsError;
 
-  MsgMap synop_;
-  MsgMap temp_;
-  MsgMap metar_;
-  MsgMap pilo_;
-  MsgMap arep_;
-  MsgMap drau_;
-  MsgMap bath_;
-  MsgMap tide_;
-  MsgMap bufrSurface_;
-  MsgMap errorMap_;
-
   wmoraport::WmoRaports raportsToCollect;
-
+  WMORaportSink *sink;
+  wmoraport::ReportFields fields; //Of the report given to the sink.
 
  public:
   WMORaport(bool warnAsError=false);
@@ -122,11 +264,30 @@ class WMORaport{
 
   WMORaport& operator=(const WMORaport &rhs);
 
-  bool split(const std::string &raport,
+  /**
+   * Split the WMO raports in \a raport. The raport is parsed where it is,
+   * it is not copied. \a raport may ie. be a view of a memory mapped file.
+   */
+  bool split(std::string_view raport,
+             const wmoraport::WmoRaports &collectRaports=wmoraport::WmoRaports() );
+
+  /**
+   * Split the WMO raports in \a raport and give the reports to \a sink
+   * as they are found. The reports is not saved, getRaports and
+   * operator<< only see the reports from the last split without a sink.
+   */
+  bool split(std::string_view raport, WMORaportSink &sink,
              const wmoraport::WmoRaports &collectRaports=wmoraport::WmoRaports() );
 
   std::string error(){ return errorStr.str();}
 
+  /**
+   * The reports of type \a type. The view is valid until the next split.
+   */
+  MsgMap msgMap( wmoraport::WmoRaport type )const {
+    return MsgMap( this, &sortedInfos_[type] );
+  }
+
   MsgMapsList getRaports( const wmoraport::WmoRaports &raports )const;
 
   friend std::ostream& operator<<(std::ostream& output,
@@ -0,0 +1,186 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <milog/milog.h>
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int nThreads)
+	:queued_(0), next_(0), stop_(false)
+{
+	if(nThreads<1)
+		nThreads=1;
+
+	for(int i=0; i<nThreads; i++)
+		queues_.push_back(std::make_unique<Queue>());
+
+	for(int i=0; i<nThreads; i++)
+		threads_.push_back(std::thread(&WorkerPool::run, this, i));
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_=true;
+	}
+
+	cond_.notify_all();
+
+	for(size_t i=0; i<threads_.size(); i++)
+		threads_[i].join();
+}
+
+void
+WorkerPool::submit(Task task)
+{
+	Queue &q=*queues_[next_++ % queues_.size()];
+
+	{
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.tasks.push_back(std::move(task));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		++queued_;
+	}
+
+	cond_.notify_one();
+}
+
+bool
+WorkerPool::pop(size_t self, Task &task)
+{
+	//Our own queue first, newest first.
+	{
+		Queue &q=*queues_[self];
+		std::lock_guard<std::mutex> lock(q.mutex);
+
+		if(!q.tasks.empty()){
+			task=std::move(q.tasks.back());
+			q.tasks.pop_back();
+			--queued_;
+			return true;
+		}
+	}
+
+	//Steal the oldest task from one of the others.
+	for(size_t i=1; i<queues_.size(); i++){
+		Queue &q=*queues_[(self+i) % queues_.size()];
+		std::lock_guard<std::mutex> lock(q.mutex);
+
+		if(!q.tasks.empty()){
+			task=std::move(q.tasks.front());
+			q.tasks.pop_front();
+			--queued_;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+WorkerPool::run(size_t self)
+{
+	Task task;
+
+	for(;;){
+		if(pop(self, task)){
+			try{
+				task();
+			}
+			catch(const std::exception &ex){
+				LOGERROR("WorkerPool: task failed: " << ex.what());
+			}
+			catch(...){
+				LOGERROR("WorkerPool: task failed: unknown exception.");
+			}
+
+			task=nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		cond_.wait(lock, [this]{ return stop_ || queued_>0;});
+
+		if(stop_ && queued_==0)
+			return;
+	}
+}
+
+
+TaskGroup::TaskGroup(WorkerPool *pool)
+	:pool_(pool), running_(0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	wait();
+}
+
+void
+TaskGroup::done()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if(--running_==0)
+		cond_.notify_all();
+}
+
+void
+TaskGroup::run(WorkerPool::Task task)
+{
+	if(!pool_){
+		task();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		++running_;
+	}
+
+	pool_->submit([this, task=std::move(task)]{
+		//Make sure done() is called, also if the task throws.
+		struct Done {
+			TaskGroup *group;
+			~Done(){ group->done();}
+		} d{this};
+
+		task();
+	});
+}
+
+void
+TaskGroup::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	cond_.wait(lock, [this]{ return running_==0;});
+}
@@ -0,0 +1,125 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __WorkerPool_h__
+#define __WorkerPool_h__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed size pool of worker threads with work stealing.
+ *
+ * Every worker has its own queue of tasks. A worker takes the
+ * newest task from its own queue, and when it is empty it steals the
+ * oldest task from one of the other workers. Tasks submitted from
+ * outside the pool is spread over the queues round robin.
+ *
+ * An exception from a task is logged and otherwise ignored.
+ */
+class WorkerPool
+{
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+
+public:
+	typedef std::function<void()> Task;
+
+private:
+	struct Queue {
+		std::mutex       mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues_;
+	std::vector<std::thread>            threads_;
+	std::mutex                          mutex_;
+	std::condition_variable             cond_;
+	std::atomic<long>                   queued_;
+	std::atomic<unsigned>               next_;
+	bool                                stop_;
+
+	void run(size_t self);
+	bool pop(size_t self, Task &task);
+
+public:
+	/**
+	 * Start \a nThreads workers, at least one.
+	 */
+	explicit WorkerPool(int nThreads);
+
+	/**
+	 * The tasks that is queued is run before the workers is stopped.
+	 */
+	~WorkerPool();
+
+	void submit(Task task);
+
+	size_t size()const{ return threads_.size();}
+};
+
+/**
+ * A group of tasks that can be waited for.
+ *
+ * If the group has no pool, the tasks is run directly by run().
+ */
+class TaskGroup
+{
+	TaskGroup(const TaskGroup&);
+	TaskGroup& operator=(const TaskGroup&);
+
+	WorkerPool              *pool_;
+	std::mutex              mutex_;
+	std::condition_variable cond_;
+	long                    running_;
+
+	void done();
+
+public:
+	explicit TaskGroup(WorkerPool *pool);
+
+	/**
+	 * Waits for the tasks that is not finished.
+	 */
+	~TaskGroup();
+
+	void run(WorkerPool::Task task);
+
+	/**
+	 * Wait until all tasks that is started with run() is finished.
+	 */
+	void wait();
+};
+
+#endif
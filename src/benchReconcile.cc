@@ -0,0 +1,149 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include "FInfo.h"
+#include "File.h"
+
+using namespace std;
+
+/*
+ * Benchmark of the reconciliation of a directory listing against
+ * the FInfoList, ie. the removal of the entries for files that
+ * no longer is in the directory.
+ *
+ * The old algorithm, a nested loop over the FInfoList and the
+ * FileList, is compared with reconcileFInfoList.
+ */
+
+namespace {
+
+void
+makeLists(int n, FileList &fileList, FInfoList &infoList)
+{
+	struct stat sbuf;
+
+	fileList.clear();
+	infoList.clear();
+	memset(&sbuf, 0, sizeof(sbuf));
+	sbuf.st_mode=S_IFREG | 0644;
+	sbuf.st_dev=1;
+
+	for(int i=0; i<n; ++i){
+		ostringstream ost;
+		ost << "/var/lib/norcom/synop/data_" << setw(6) << setfill('0') << i;
+		sbuf.st_ino=i+1;
+		sbuf.st_mtime=1000+i;
+		File f(ost.str(), sbuf);
+
+		infoList[f.name()]=FInfo(f);
+
+		//Every 100th file is gone from the directory.
+		if(i%100!=0)
+			fileList.push_back(f);
+	}
+}
+
+void
+nestedLoop(FInfoList &infoList, const FileList &fileList)
+{
+	CIFileList it;
+	IFInfoList fiIt=infoList.begin();
+	IFInfoList tmpFiIt;
+
+	while(fiIt!=infoList.end()){
+		for(it=fileList.begin(); it!=fileList.end(); it++){
+			if(it->name()==fiIt->first)
+				break;
+		}
+
+		if(it==fileList.end()){
+			tmpFiIt=fiIt;
+			fiIt++;
+			infoList.erase(tmpFiIt);
+		}else{
+			fiIt++;
+		}
+	}
+}
+
+double
+usecs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(
+			std::chrono::steady_clock::now()-start).count();
+}
+
+}
+
+int
+main(int argn, char **argv)
+{
+	const int sizes[]={100, 1000, 10000, 100000};
+	//The nested loop is quadratic, dont run it on the largest sizes
+	//unless asked for.
+	bool all=argn>1 && string(argv[1])=="--all";
+	FileList  fileList;
+	FInfoList infoList;
+	std::list<std::string> erased;
+	RenamedList renamed;
+
+	cout << setw(8) << "files" << setw(16) << "nested (us)"
+	     << setw(16) << "reconcile (us)" << endl;
+
+	for(int n : sizes){
+		cout << setw(8) << n;
+
+		makeLists(n, fileList, infoList);
+
+		if(all || n<=10000){
+			auto start=std::chrono::steady_clock::now();
+			nestedLoop(infoList, fileList);
+			cout << setw(16) << fixed << setprecision(0) << usecs(start);
+		}else{
+			cout << setw(16) << "-";
+		}
+
+		makeLists(n, fileList, infoList);
+		auto start=std::chrono::steady_clock::now();
+		reconcileFInfoList(infoList, fileList, erased, renamed);
+		cout << setw(16) << fixed << setprecision(0) << usecs(start) << endl;
+
+		if(erased.size()!=static_cast<size_t>((n+99)/100)){
+			cerr << "ERROR: expected " << (n+99)/100 << " erased entries, got "
+			     << erased.size() << endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,268 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include "ScanKernels.h"
+
+using namespace std;
+
+/*
+ * Benchmark of the scanning kernels in ScanKernels.h against the per
+ * character loops ReportIterator used before, ie. the loops over
+ * isalnum and strchr in skipEmptyLines and readReport.
+ *
+ * The bulletins are scanned line by line as ReportIterator does, the
+ * line breaks and the characters of the line. The files to scan is
+ * given on the command line, default all files in the directory
+ * synop.
+ */
+
+namespace {
+
+size_t
+spanLineCharsLoop( const char *p, size_t n )
+{
+	size_t i=0;
+
+	for( ; i < n; ++i ) {
+		char ch=p[i];
+
+		if( ! ( isalnum( static_cast<unsigned char>( ch ) ) ||
+				ch == ' ' || ch == '/' || ch == '=' ) )
+			break;
+	}
+
+	return i;
+}
+
+size_t
+spanLineBreaksLoop( const char *p, size_t n, bool withSpace )
+{
+	const char *what=withSpace ? " \t\r\n" : "\t\r\n";
+	size_t i=0;
+
+	for( ; i < n; ++i ) {
+		if( p[i] == '\0' || ! strchr( what, p[i] ) )
+			break;
+	}
+
+	return i;
+}
+
+typedef size_t ( *SpanLineChars )( const char *p, size_t n );
+typedef size_t ( *SpanLineBreaks )( const char *p, size_t n, bool withSpace );
+
+/**
+ * Scan buf as ReportIterator::readLine, return a checksum of the
+ * lines found.
+ */
+size_t
+scan( const string &buf, SpanLineChars lineChars, SpanLineBreaks lineBreaks )
+{
+	const char *p=buf.data();
+	size_t n=buf.size();
+	size_t i=0;
+	size_t sum=0;
+
+	while( i < n ) {
+		i+=lineBreaks( p + i, n - i, true );
+		size_t len=lineChars( p + i, n - i );
+		sum=sum * 31 + len;
+		i+=len + 1;
+
+		if( i < n )
+			i+=lineBreaks( p + i, n - i, false );
+	}
+
+	return sum;
+}
+
+bool
+readFiles( int argn, char **argv, vector<string> &files )
+{
+	vector<string> names;
+
+	if( argn > 1 ) {
+		for( int i=1; i < argn; ++i )
+			names.push_back( argv[i] );
+	} else {
+		DIR *dir=opendir( "synop" );
+
+		if( ! dir )
+			return false;
+
+		while( struct dirent *ent=readdir( dir ) ) {
+			if( ent->d_name[0] != '.' )
+				names.push_back( string( "synop/" ) + ent->d_name );
+		}
+
+		closedir( dir );
+	}
+
+	for( const string &name : names ) {
+		ifstream fs( name.c_str() );
+		ostringstream ost;
+
+		if( ! fs ) {
+			cerr << "ERROR: Cant open the file '" << name << "'." << endl;
+			return false;
+		}
+
+		ost << fs.rdbuf();
+		files.push_back( ost.str() );
+	}
+
+	return ! files.empty();
+}
+
+/**
+ * Check the kernels in use against the loops on all the bytes, at
+ * all the offsets and lengths that covers the vector tails.
+ */
+bool
+check()
+{
+	string buf( 256 + 64, ' ' );
+	mt19937 rand( 17 );
+
+	for( int round=0; round < 200; ++round ) {
+		for( size_t i=0; i < buf.size(); ++i ) {
+			//Mostly the characters in the classes, so the runs is long.
+			if( rand() % 8 == 0 )
+				buf[i]=static_cast<char>( rand() % 256 );
+			else
+				buf[i]=" /=\t\r\nA0z"[rand() % 9];
+		}
+
+		if( round == 0 ) {
+			for( size_t i=0; i < 256; ++i )
+				buf[i]=static_cast<char>( i );
+		}
+
+		for( size_t off=0; off < 64; ++off ) {
+			for( size_t len=0; off + len <= buf.size(); len+= ( len < 70 ? 1 : 37 ) ) {
+				const char *p=buf.data() + off;
+
+				if( wmoraport::spanLineChars( p, len ) != spanLineCharsLoop( p, len ) ||
+						wmoraport::spanLineBreaks( p, len, true ) != spanLineBreaksLoop( p, len, true ) ||
+						wmoraport::spanLineBreaks( p, len, false ) != spanLineBreaksLoop( p, len, false ) ) {
+					cerr << "ERROR: the " << wmoraport::scanKernels()
+					     << " kernels differs from the loops at offset " << off
+					     << ", length " << len << "." << endl;
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+double
+usecs( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration<double, std::micro>(
+			std::chrono::steady_clock::now() - start ).count();
+}
+
+}
+
+int
+main( int argn, char **argv )
+{
+	const int ROUNDS=200;
+	const char *kernels[]={ "scalar", "sse2", "avx2" };
+	vector<string> files;
+	size_t bytes=0;
+	size_t expected=0;
+	string chosen=wmoraport::scanKernels();
+
+	if( ! readFiles( argn, argv, files ) ) {
+		cerr << "ERROR: No files to scan." << endl;
+		return 1;
+	}
+
+	for( const string &f : files )
+		bytes+=f.size();
+
+	cout << "files: " << files.size() << ", bytes: " << bytes
+	     << ", rounds: " << ROUNDS << ", chosen kernels: " << chosen << endl;
+	cout << setw( 10 ) << "kernels" << setw( 12 ) << "time (us)"
+	     << setw( 12 ) << "MB/s" << endl;
+
+	for( int k=-1; k < 3; ++k ) {
+		SpanLineChars lineChars=spanLineCharsLoop;
+		SpanLineBreaks lineBreaks=spanLineBreaksLoop;
+
+		if( k >= 0 ) {
+			if( ! wmoraport::useScanKernels( kernels[k] ) ) {
+				cout << setw( 10 ) << kernels[k] << setw( 12 ) << "-" << endl;
+				continue;
+			}
+
+			if( ! check() )
+				return 1;
+
+			lineChars=wmoraport::spanLineChars;
+			lineBreaks=wmoraport::spanLineBreaks;
+		}
+
+		size_t sum=0;
+		auto start=std::chrono::steady_clock::now();
+
+		for( int r=0; r < ROUNDS; ++r ) {
+			for( const string &f : files )
+				sum+=scan( f, lineChars, lineBreaks );
+		}
+
+		double us=usecs( start );
+
+		if( k < 0 ) {
+			expected=sum;
+		} else if( sum != expected ) {
+			cerr << "ERROR: the " << kernels[k] << " kernels found other lines than the loops." << endl;
+			return 1;
+		}
+
+		cout << setw( 10 ) << ( k < 0 ? "loops" : kernels[k] )
+		     << setw( 12 ) << fixed << setprecision( 0 ) << us
+		     << setw( 12 ) << fixed << setprecision( 0 ) << bytes * ROUNDS / us << endl;
+	}
+
+	return 0;
+}
@@ -112,3 +112,21 @@ crc_ccitt(const std::string &buf)
     
   return (unsigned short)crc;
 }
+
+unsigned int
+crc_ccitt(const char *buf, size_t len, unsigned int crc)
+{
+  unsigned int n;
+  const char *end=buf+len;
+
+  crc &= 0xffff;
+
+  while (buf!=end){
+    n = *buf++ ^ crc;
+
+    /* Henter verdier fra tabellene ccitt_l og ccitt_h */
+    crc = ccitt_l[n&0x0f] ^ ccitt_h[(n>>4)&0x0f] ^ (crc>>8);
+  };
+
+  return (unsigned short)crc;
+}
@@ -31,6 +31,7 @@
 #ifndef __crc_ccitt_BM314_h__
 #define __crc_ccitt_BM314_h__
 
+#include <stddef.h>
 #include <string>
 
 /**
@@ -42,5 +43,12 @@ crc_ccitt(const char *in);
 unsigned int  
 crc_ccitt(const std::string &buf);
 
+/**
+ * Compute the crc of \a len bytes from \a buf. The crc is continued
+ * from \a crc, ie. crc_ccitt(b, lb, crc_ccitt(a)) == crc_ccitt(a+b).
+ */
+unsigned int
+crc_ccitt(const char *buf, size_t len, unsigned int crc=0);
+
 
 #endif
@@ -0,0 +1,122 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <iostream>
+#include <string>
+#include <random>
+#include <miutil/base64.h>
+#include "Base64.h"
+
+using namespace std;
+
+/*
+ * Test that wmoraport::encodeBase64 gives the same result as
+ * miutil::encode64, for all the encoders the CPU supports. The input
+ * is random bytes, all the lengths up to a few vectors and some
+ * larger, at all the alignments.
+ */
+
+namespace {
+
+bool
+test( const string &buf, size_t off, size_t n )
+{
+	string expected;
+	string result( wmoraport::base64Size( n ) + 1, '#' );
+
+	miutil::encode64( buf.data() + off, n, expected );
+	char *end=wmoraport::encodeBase64( buf.data() + off, n, &result[0] );
+
+	if( static_cast<size_t>( end - result.data() ) != wmoraport::base64Size( n ) ||
+			result[result.size() - 1] != '#' ) {
+		cerr << "ERROR: " << wmoraport::base64Kernels() << ": offset " << off
+		     << ", size " << n << ": wrong size of the result." << endl;
+		return false;
+	}
+
+	result.erase( result.size() - 1 );
+
+	if( result != expected ) {
+		cerr << "ERROR: " << wmoraport::base64Kernels() << ": offset " << off
+		     << ", size " << n << ":" << endl
+		     << "   expected: " << expected << endl
+		     << "        got: " << result << endl;
+		return false;
+	}
+
+	return true;
+}
+
+}
+
+int
+main()
+{
+	const char *encoders[]={ "scalar", "ssse3", "avx2" };
+	mt19937 rand( 42 );
+	string buf( 70000, '\0' );
+	int errors=0;
+
+	for( size_t i=0; i < buf.size(); ++i )
+		buf[i]=static_cast<char>( rand() );
+
+	//All the byte values at the start.
+	for( size_t i=0; i < 256; ++i )
+		buf[i]=static_cast<char>( i );
+
+	for( const char *name : encoders ) {
+		if( ! wmoraport::useBase64Kernels( name ) ) {
+			cout << name << ": not supported by the CPU." << endl;
+			continue;
+		}
+
+		int tests=0;
+
+		for( size_t off=0; off < 32; ++off ) {
+			for( size_t n=0; n <= 300; ++n, ++tests ) {
+				if( ! test( buf, off, n ) && ++errors > 10 )
+					return 1;
+			}
+		}
+
+		for( size_t n=1000; n + 64 <= buf.size(); n=n * 2 + 7, ++tests ) {
+			if( ! test( buf, 64 - n % 7, n ) && ++errors > 10 )
+				return 1;
+		}
+
+		cout << name << ": " << tests << " tests." << endl;
+	}
+
+	if( errors ) {
+		cerr << errors << " tests failed." << endl;
+		return 1;
+	}
+
+	cout << "OK" << endl;
+	return 0;
+}
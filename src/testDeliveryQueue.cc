@@ -0,0 +1,449 @@
+/*
+  Kvalobs - Free Quality Control Software for Meteorological Observations 
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: kvalobs-dev@met.no
+
+  This file is part of KVALOBS
+
+  KVALOBS is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as 
+  published by the Free Software Foundation; either version 2 
+  of the License, or (at your option) any later version.
+  
+  KVALOBS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along 
+  with KVALOBS; if not, write to the Free Software Foundation Inc., 
+  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <boost/filesystem.hpp>
+#include "DeliveryQueue.h"
+#include "KvDelivery.h"
+
+using namespace std;
+using kvalobs::datasource::Result;
+
+/*
+ * Test the DeliveryQueue and the KvDelivery on a temporary directory.
+ * The queue is tested for the recovery of a log that was not completely
+ * written, the cursor files and the removal of the segments. The
+ * KvDelivery is tested for the sending of a batch one by one and for
+ * giving up a message. KvSender.cc is not linked in, the KvSender
+ * below answers the messages with the function answer.
+ */
+
+namespace {
+
+int errors=0;
+
+//The messages sent to the KvSender, and the answer to them.
+std::mutex sentMutex;
+vector<string> sent;
+std::function<Result( const string &msg )> answer;
+
+void
+check( bool ok, const string &what )
+{
+	if( ! ok ) {
+		cerr << "ERROR: " << what << endl;
+		errors++;
+	}
+}
+
+string
+newDir( const string &top, const string &name )
+{
+	string dir=top + "/" + name + "/";
+	boost::filesystem::create_directory( dir );
+	return dir;
+}
+
+size_t
+countSegments( const string &dir )
+{
+	size_t n=0;
+
+	for( boost::filesystem::directory_iterator it( dir ); it != boost::filesystem::directory_iterator(); ++it ) {
+		if( it->path().extension() == ".log" )
+			n++;
+	}
+
+	return n;
+}
+
+void
+writeFile( const string &file, const string &content )
+{
+	ofstream fs( file.c_str(), ios::trunc );
+	fs << content;
+}
+
+string
+readFile( const string &file )
+{
+	ifstream fs( file.c_str() );
+	return string( istreambuf_iterator<char>( fs ), istreambuf_iterator<char>() );
+}
+
+bool
+readMsg( const DeliveryQueue &queue, unsigned long long seq, const string &msg )
+{
+	DeliveryQueue::Record rec;
+	return queue.read( seq, rec ) == DeliveryQueue::READ_OK && rec.seq == seq && rec.msg == msg;
+}
+
+/*
+ * Wait up to \a ms milliseconds for \a done.
+ */
+bool
+waitFor( std::function<bool()> done, int ms )
+{
+	for( ; ms > 0 && ! done(); ms -= 10 )
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+
+	return done();
+}
+
+/*
+ * The last message is cut off when it is not completely written, or
+ * it has a wrong crc. The messages before it is kept, and the next
+ * message gets its sequence number.
+ */
+void
+testRecover( const string &top )
+{
+	string dir=newDir( top, "recover" );
+	string segment=dir + "00000000000000000000.log";
+	TKvDataSrcList servers( 1, "kv1" );
+
+	{
+		DeliveryQueue queue( dir, servers );
+		check( queue.open(), "recover: open a new queue." );
+
+		for( int i=0; i < 3; i++ )
+			queue.append( "synop", "AAXX " + to_string( i ) );
+
+		check( queue.sync() && queue.end() == 3, "recover: append 3 messages." );
+	}
+
+	off_t size=boost::filesystem::file_size( segment );
+	check( truncate( segment.c_str(), size - 2 ) == 0, "recover: truncate the segment." );
+
+	{
+		DeliveryQueue queue( dir, servers );
+		DeliveryQueue::Record rec;
+
+		check( queue.open(), "recover: open the torn log." );
+		check( queue.end() == 2, "recover: the torn message is cut off." );
+		check( readMsg( queue, 1, "AAXX 1" ), "recover: the message before the torn one is kept." );
+		check( queue.read( 2, rec ) == DeliveryQueue::READ_MISSING, "recover: the torn message is missing." );
+		check( queue.append( "synop", "AAXX 2" ) && queue.sync() && readMsg( queue, 2, "AAXX 2" ),
+		       "recover: append after the torn message." );
+	}
+
+	//Change the last byte of the last message, the crc is wrong.
+	string log=readFile( segment );
+	log[log.size() - 1]='X';
+	writeFile( segment, log );
+
+	{
+		DeliveryQueue queue( dir, servers );
+
+		check( queue.open(), "recover: open the corrupt log." );
+		check( queue.end() == 2, "recover: the message with a wrong crc is cut off." );
+		check( boost::filesystem::file_size( segment ) == static_cast<uintmax_t>( size / 3 * 2 ),
+		       "recover: the segment is truncated." );
+		check( readMsg( queue, 0, "AAXX 0" ) && readMsg( queue, 1, "AAXX 1" ),
+		       "recover: the messages before the corrupt one is kept." );
+	}
+}
+
+/*
+ * A kvserver without a cursor file starts at the end of the log, a
+ * cursor file that cant be read sends the log again and a cursor
+ * ahead of the log moves the end of the log.
+ */
+void
+testCursors( const string &top )
+{
+	string dir=newDir( top, "cursors" );
+	TKvDataSrcList servers( 1, "kv1" );
+
+	{
+		DeliveryQueue queue( dir, servers );
+		check( queue.open(), "cursors: open a new queue." );
+
+		for( int i=0; i < 3; i++ )
+			queue.append( "synop", "AAXX " + to_string( i ) );
+
+		queue.sync();
+		queue.setCursor( 0, 1 );
+		queue.saveCursors();
+	}
+
+	servers.push_back( "kv2" );
+
+	{
+		DeliveryQueue queue( dir, servers );
+		check( queue.open(), "cursors: open with a new kvserver." );
+		check( queue.cursor( 0 ) == 1, "cursors: the saved cursor is read." );
+		check( queue.cursor( 1 ) == 3, "cursors: a missing cursor starts at the end of the log." );
+	}
+
+	check( readFile( dir + "cursor_kv2" ) == "3\n", "cursors: the cursor of a new kvserver is saved." );
+	writeFile( dir + "cursor_kv1", "" );
+
+	{
+		DeliveryQueue queue( dir, servers );
+		check( queue.open(), "cursors: open with an empty cursor." );
+		check( queue.cursor( 0 ) == 0, "cursors: an empty cursor sends all the log." );
+	}
+
+	writeFile( dir + "cursor_kv1", "10\n" );
+
+	{
+		DeliveryQueue queue( dir, servers );
+		DeliveryQueue::Record rec;
+
+		check( queue.open(), "cursors: open with a cursor ahead of the log." );
+		check( queue.cursor( 0 ) == 10 && queue.end() == 10, "cursors: a cursor ahead of the log moves the end." );
+		check( queue.read( 5, rec ) == DeliveryQueue::READ_MISSING, "cursors: the messages before the cursor is missing." );
+		check( queue.append( "synop", "AAXX 10" ) && queue.sync() && readMsg( queue, 10, "AAXX 10" ),
+		       "cursors: append after a cursor ahead of the log." );
+	}
+}
+
+/*
+ * A segment is removed when the slowest kvserver is past it.
+ */
+void
+testSegments( const string &top )
+{
+	string dir=newDir( top, "segments" );
+	TKvDataSrcList servers;
+	string msg( 1024 * 1024, 'x' );
+
+	servers.push_back( "kv1" );
+	servers.push_back( "kv2" );
+
+	{
+		DeliveryQueue queue( dir, servers );
+		DeliveryQueue::Record rec;
+
+		check( queue.open(), "segments: open a new queue." );
+
+		//The segments is 16 MB, the messages from 16 is in the second.
+		for( int i=0; i < 20; i++ )
+			queue.append( "synop", msg );
+
+		queue.sync();
+		check( countSegments( dir ) == 2, "segments: the log has 2 segments." );
+
+		queue.setCursor( 0, 20 );
+		queue.setCursor( 1, 10 );
+		queue.saveCursors();
+		check( countSegments( dir ) == 2, "segments: a segment is kept for the slowest kvserver." );
+
+		queue.setCursor( 1, 16 );
+		queue.saveCursors();
+		check( countSegments( dir ) == 1, "segments: a segment is removed when all the kvservers is past it." );
+		check( queue.read( 15, rec ) == DeliveryQueue::READ_MISSING, "segments: the removed messages is missing." );
+		check( readMsg( queue, 16, msg ), "segments: the messages in the last segment is kept." );
+	}
+
+	{
+		DeliveryQueue queue( dir, servers );
+		check( queue.open() && queue.end() == 20 && queue.cursor( 1 ) == 16,
+		       "segments: open the log after a segment is removed." );
+	}
+}
+
+/*
+ * A batch kvalobs does not accept is sent again one by one.
+ */
+void
+testBatchFallback( const string &top )
+{
+	string dir=newDir( top, "batch" );
+	TKvDataSrcList servers( 1, "kv1" );
+	DeliveryQueue queue( dir, servers );
+	KvDelivery::Conf conf;
+
+	conf.batchDecoders.insert( "synop" );
+	conf.batchSize=10;
+	conf.batchLingerMs=100;
+	conf.data2kvdir=dir;
+
+	sent.clear();
+	answer=[]( const string &msg ) {
+		Result res;
+
+		if( msg.find( '\n' ) != string::npos ) {
+			res.res=kvalobs::datasource::DECODEERROR;
+			res.message="unknown station/position";
+		}
+
+		return res;
+	};
+
+	check( queue.open(), "batch: open a new queue." );
+
+	for( int i=0; i < 3; i++ )
+		queue.append( "synop", "AAXX " + to_string( i ) );
+
+	queue.sync();
+
+	{
+		KvDelivery delivery( queue, 0, "kv1", conf, 1000 );
+		delivery.start();
+		check( waitFor( [&queue]() { return queue.cursor( 0 ) == 3; }, 5000 ),
+		       "batch: the messages is delivered." );
+	}
+
+	std::lock_guard<std::mutex> lock( sentMutex );
+	vector<string> expected={ "AAXX 0\nAAXX 1\nAAXX 2\n", "AAXX 0", "AAXX 1", "AAXX 2" };
+
+	check( sent == expected, "batch: the batch is sent, and then the messages one by one." );
+}
+
+/*
+ * A message kvalobs does not save is given up when it has failed
+ * maxRetries times while kvalobs saved other messages.
+ */
+void
+testGiveUp( const string &top )
+{
+	string dir=newDir( top, "giveup" );
+	string failed=dir + "kvfailed_synop_kv1_0";
+	TKvDataSrcList servers( 1, "kv1" );
+	DeliveryQueue queue( dir, servers );
+	KvDelivery::Conf conf;
+	int i=0;
+
+	conf.maxRetries=2;
+	conf.data2kvdir=dir;
+
+	sent.clear();
+	answer=[]( const string &msg ) {
+		Result res;
+
+		if( msg.find( "POISON" ) != string::npos ) {
+			res.res=kvalobs::datasource::NOTSAVED;
+			res.message="not saved";
+		}
+
+		return res;
+	};
+
+	check( queue.open(), "giveup: open a new queue." );
+	queue.append( "synop", "AAXX POISON" );
+	queue.sync();
+
+	{
+		KvDelivery delivery( queue, 0, "kv1", conf, 1000 );
+		delivery.start();
+
+		//kvalobs must save other messages between the tries.
+		check( waitFor( [&]() {
+		                   queue.append( "synop", "AAXX " + to_string( ++i ) );
+		                   queue.sync();
+		                   delivery.wakeUp();
+		                   return boost::filesystem::exists( failed ); }, 10000 ),
+		       "giveup: the message is given up." );
+		check( waitFor( [&queue]() { return queue.cursor( 0 ) == queue.end(); }, 5000 ),
+		       "giveup: the cursor is moved past the message given up." );
+	}
+
+	std::lock_guard<std::mutex> lock( sentMutex );
+	int tries=0;
+
+	for( const string &msg : sent )
+		tries += msg == "AAXX POISON";
+
+	check( tries == conf.maxRetries + 1, "giveup: the message is sent maxRetries+1 times, it is sent "
+	       + to_string( tries ) + " times." );
+	check( readFile( failed ) == "synop\nAAXX POISON\n", "giveup: the message is saved." );
+}
+
+}
+
+/*
+ * The KvSender answers at once, from the thread that sends.
+ */
+KvSender::KvSender( const std::string &kvserver, int timeoutMs, int connections_, int window_ )
+	: name( kvserver ), timeout( timeoutMs ), window( window_ ), maxAbandoned( connections_ ),
+	  queue( window_ ), occupied( 0 ), stopping( false )
+{
+}
+
+KvSender::~KvSender()
+{
+}
+
+bool
+KvSender::sendAsync( const std::string &message, const std::string &obsType,
+                     Callback callback )
+{
+	{
+		std::lock_guard<std::mutex> lock( sentMutex );
+		sent.push_back( message );
+	}
+
+	callback( answer( message ), name, false );
+	return true;
+}
+
+void
+KvSender::stop()
+{
+}
+
+void
+KvSender::drain()
+{
+}
+
+int
+main()
+{
+	char top[]="/tmp/testDeliveryQueueXXXXXX";
+
+	if( ! mkdtemp( top ) ) {
+		cerr << "Cant create a temporary directory." << endl;
+		return 1;
+	}
+
+	testRecover( top );
+	testCursors( top );
+	testSegments( top );
+	testBatchFallback( top );
+	testGiveUp( top );
+
+	boost::filesystem::remove_all( top );
+
+	if( errors ) {
+		cerr << errors << " tests failed." << endl;
+		return 1;
+	}
+
+	cout << "OK" << endl;
+	return 0;
+}
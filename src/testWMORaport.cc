@@ -131,7 +131,7 @@ printWmoRaport(const WMORaport &wmoRaports,
 			continue;
 		}
 
-		BOOST_FOREACH( WMORaport::MsgMap::value_type msgValList, *raport.second ) {
+		BOOST_FOREACH( WMORaport::MsgMap::value_type msgValList, raport.second ) {
 			ostDecoder.str("");
 			ostDecoder << theDecoder;
 			if( ! msgValList.first.decoderExtra.empty() )